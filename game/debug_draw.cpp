@@ -0,0 +1,131 @@
+#include "debug_draw.h"
+
+#ifdef ALMOND_DEBUG_DRAW
+
+#include "../src/logger.h"
+
+#include <cmath>
+
+#define DEBUG_CIRCLE_SEGMENTS 24
+
+DebugVertex* debug_draw_lines(DrawList* draw_list, uint32_t line_count)
+{
+    uint32_t vertex_count = line_count * 2;
+
+    auto* cmd = (DebugLinesCommand*)draw_list_push(draw_list, DrawCommandType::DebugLines,
+        sizeof(DebugLinesCommand) + vertex_count * sizeof(DebugVertex));
+    if (!cmd) {
+        log_err("Out of draw list memory");
+        return NULL;
+    }
+
+    cmd->vertex_count = vertex_count;
+
+    return (DebugVertex*)(cmd + 1);
+}
+
+void debug_draw_line(DrawList* draw_list, glm::vec3 from, glm::vec3 to, uint32_t color)
+{
+    DebugVertex* vertices = debug_draw_lines(draw_list, 1);
+    if (!vertices) {
+        return;
+    }
+
+    vertices[0] = { from, color };
+    vertices[1] = { to, color };
+}
+
+void debug_draw_aabb(DrawList* draw_list, glm::vec3 min, glm::vec3 max, uint32_t color)
+{
+    DebugVertex* vertices = debug_draw_lines(draw_list, 12);
+    if (!vertices) {
+        return;
+    }
+
+    glm::vec3 corners[8];
+    for (int i = 0; i < 8; i++) {
+        corners[i] = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+    }
+
+    // Corners one bit apart share an edge
+    static const uint8_t edges[12][2] = {
+        { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+        { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+        { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 },
+    };
+
+    for (int i = 0; i < 12; i++) {
+        vertices[i * 2] = { corners[edges[i][0]], color };
+        vertices[i * 2 + 1] = { corners[edges[i][1]], color };
+    }
+}
+
+// Writes segments lines of an arc from angle start to end around center in
+// the plane spanned by axis_a and axis_b
+static DebugVertex* write_arc(DebugVertex* vertices, glm::vec3 center, glm::vec3 axis_a, glm::vec3 axis_b,
+    float radius, float start, float end, int segments, uint32_t color)
+{
+    glm::vec3 previous = center + (axis_a * cosf(start) + axis_b * sinf(start)) * radius;
+
+    for (int i = 1; i <= segments; i++) {
+        float angle = start + (end - start) * (float)i / (float)segments;
+        glm::vec3 point = center + (axis_a * cosf(angle) + axis_b * sinf(angle)) * radius;
+
+        *vertices++ = { previous, color };
+        *vertices++ = { point, color };
+        previous = point;
+    }
+
+    return vertices;
+}
+
+void debug_draw_sphere(DrawList* draw_list, glm::vec3 center, float radius, uint32_t color)
+{
+    DebugVertex* vertices = debug_draw_lines(draw_list, 3 * DEBUG_CIRCLE_SEGMENTS);
+    if (!vertices) {
+        return;
+    }
+
+    const float full = 2.0f * (float)M_PI;
+    glm::vec3 x = glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 y = glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 z = glm::vec3(0.0f, 0.0f, 1.0f);
+
+    vertices = write_arc(vertices, center, x, y, radius, 0.0f, full, DEBUG_CIRCLE_SEGMENTS, color);
+    vertices = write_arc(vertices, center, y, z, radius, 0.0f, full, DEBUG_CIRCLE_SEGMENTS, color);
+    write_arc(vertices, center, z, x, radius, 0.0f, full, DEBUG_CIRCLE_SEGMENTS, color);
+}
+
+void debug_draw_capsule(DrawList* draw_list, glm::vec3 center, float half_height, float radius, uint32_t color)
+{
+    const int half_segments = DEBUG_CIRCLE_SEGMENTS / 2;
+
+    // Two rings, four side lines and two half circle arcs per cap
+    DebugVertex* vertices = debug_draw_lines(draw_list, 2 * DEBUG_CIRCLE_SEGMENTS + 4 + 4 * half_segments);
+    if (!vertices) {
+        return;
+    }
+
+    const float pi = (float)M_PI;
+    glm::vec3 x = glm::vec3(1.0f, 0.0f, 0.0f);
+    glm::vec3 y = glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 z = glm::vec3(0.0f, 0.0f, 1.0f);
+    glm::vec3 top = center + y * half_height;
+    glm::vec3 bottom = center - y * half_height;
+
+    vertices = write_arc(vertices, top, x, z, radius, 0.0f, 2.0f * pi, DEBUG_CIRCLE_SEGMENTS, color);
+    vertices = write_arc(vertices, bottom, x, z, radius, 0.0f, 2.0f * pi, DEBUG_CIRCLE_SEGMENTS, color);
+
+    glm::vec3 sides[4] = { x, -x, z, -z };
+    for (int i = 0; i < 4; i++) {
+        *vertices++ = { top + sides[i] * radius, color };
+        *vertices++ = { bottom + sides[i] * radius, color };
+    }
+
+    vertices = write_arc(vertices, top, x, y, radius, 0.0f, pi, half_segments, color);
+    vertices = write_arc(vertices, top, z, y, radius, 0.0f, pi, half_segments, color);
+    vertices = write_arc(vertices, bottom, x, y, radius, pi, 2.0f * pi, half_segments, color);
+    write_arc(vertices, bottom, z, y, radius, pi, 2.0f * pi, half_segments, color);
+}
+
+#endif
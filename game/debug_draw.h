@@ -0,0 +1,34 @@
+#pragma once
+
+#include <almond.h>
+
+// Immediate mode debug shapes, appended to the draw list as line commands.
+// The renderer draws every line of a frame with a single call. Without
+// ALMOND_DEBUG_DRAW, as in Distribution builds, all of it compiles to nothing.
+
+inline uint32_t debug_color(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255)
+{
+    return (uint32_t)r | (uint32_t)g << 8 | (uint32_t)b << 16 | (uint32_t)a << 24;
+}
+
+#ifdef ALMOND_DEBUG_DRAW
+
+// Reserves line_count lines, two vertices each, NULL when out of memory
+DebugVertex* debug_draw_lines(DrawList* draw_list, uint32_t line_count);
+
+void debug_draw_line(DrawList* draw_list, glm::vec3 from, glm::vec3 to, uint32_t color);
+void debug_draw_aabb(DrawList* draw_list, glm::vec3 min, glm::vec3 max, uint32_t color);
+// Three great circles
+void debug_draw_sphere(DrawList* draw_list, glm::vec3 center, float radius, uint32_t color);
+// Upright, half_height is the half length of the cylinder part
+void debug_draw_capsule(DrawList* draw_list, glm::vec3 center, float half_height, float radius, uint32_t color);
+
+#else
+
+inline DebugVertex* debug_draw_lines(DrawList*, uint32_t) { return NULL; }
+inline void debug_draw_line(DrawList*, glm::vec3, glm::vec3, uint32_t) { }
+inline void debug_draw_aabb(DrawList*, glm::vec3, glm::vec3, uint32_t) { }
+inline void debug_draw_sphere(DrawList*, glm::vec3, float, uint32_t) { }
+inline void debug_draw_capsule(DrawList*, glm::vec3, float, float, uint32_t) { }
+
+#endif
@@ -1,6 +1,7 @@
 #include <almond.h>
 
 #include "arena.h"
+#include "debug_draw.h"
 #include "gltf_loader.h"
 #include "map.h"
 #include "physics.h"
@@ -23,10 +24,13 @@ typedef struct {
     size_t meshes_count;
 
     TextureHandle test_texture;
+    MaterialHandle test_material;
 
     float camera_yaw;
     float camera_pitch;
     float camera_distance;
+
+    bool debug_draw;
 } GameState;
 
 typedef struct {
@@ -34,10 +38,55 @@ typedef struct {
     GameState* game_state;
 } MapParsingState;
 
+// Everything the camera depends on, stored in the draw list so the platform
+// can rebuild the camera with fresher mouse input through late_latch_camera
+typedef struct {
+    glm::vec3 target;
+    float yaw;
+    float pitch;
+    float distance;
+} CameraRig;
+
+static_assert(sizeof(CameraRig) <= LATE_LATCH_DATA_SIZE, "CameraRig does not fit in the draw list");
+
+static const float mouse_sensitivity = 0.15f;
+
+static void camera_rig_look(CameraRig* rig, glm::vec2 mouse_movement)
+{
+    rig->yaw -= mouse_movement.x * mouse_sensitivity;
+    rig->pitch -= mouse_movement.y * mouse_sensitivity;
+
+    // Clamp pitch to prevent camera flipping
+    rig->pitch = glm::clamp(rig->pitch, -89.0f, 89.0f);
+}
+
+static glm::vec3 camera_rig_forward(const CameraRig* rig)
+{
+    float yaw_rad = rig->yaw * ((float)M_PI / 180.0f);
+    float pitch_rad = rig->pitch * ((float)M_PI / 180.0f);
+
+    return glm::vec3(
+        cosf(pitch_rad) * sinf(yaw_rad),
+        sinf(pitch_rad),
+        cosf(pitch_rad) * cosf(yaw_rad));
+}
+
+// Positions the camera behind and above the target
+static Camera camera_rig_camera(const CameraRig* rig)
+{
+    Camera camera;
+    camera.position = rig->target - camera_rig_forward(rig) * rig->distance;
+    camera.target = rig->target;
+
+    return camera;
+}
+
 void load_callback(MapEntity* entity, void* user_data, Arena& temp_arena)
 {
     MapParsingState* state = (MapParsingState*)user_data;
 
+    MeshData* mesh_datas = temp_arena.PushArray<MeshData>(entity->brushes_count);
+
     for (size_t i = 0; i < entity->brushes_count; i++) {
         MeshData mesh_data = brush_to_mesh(entity->brushes[i], temp_arena);
 
@@ -49,11 +98,16 @@ void load_callback(MapEntity* entity, void* user_data, Arena& temp_arena)
             mesh_data.vertices[i].position.z = -temp / 40.f;
         }
 
-        state->game_state->meshes[state->game_state->meshes_count++] = state->api->create_mesh(&mesh_data);
+        mesh_datas[i] = mesh_data;
+
         BodyID id = create_convex_hull_static_collider(state->game_state->physics_world, &mesh_data, temp_arena);
 
         printf("%u\n", id);
     }
+
+    // Upload every brush of the entity in a single batch
+    state->api->create_meshes(mesh_datas, entity->brushes_count, &state->game_state->meshes[state->game_state->meshes_count]);
+    state->game_state->meshes_count += entity->brushes_count;
 }
 
 extern "C" GAME_ITERATE(game_iterate)
@@ -104,32 +158,23 @@ extern "C" GAME_ITERATE(game_iterate)
         game_state->camera_distance = 10.0f;
 
         game_state->test_texture = load_texture("wall.png", api);
+        game_state->test_material = api->create_material(game_state->test_texture, MATERIAL_FLAGS_NONE);
 
         memory->is_initialized = true;
     }
 
-    const float mouse_sensitivity = 0.15f;
-    game_state->camera_yaw -= input->mouse_movement.x * mouse_sensitivity;
-    game_state->camera_pitch -= input->mouse_movement.y * mouse_sensitivity;
+    CameraRig rig = {
+        .yaw = game_state->camera_yaw,
+        .pitch = game_state->camera_pitch,
+        .distance = game_state->camera_distance,
+    };
 
-    // Clamp pitch to prevent camera flipping
-    const float pitch_min = -89.0f;
-    const float pitch_max = 89.0f;
-    if (game_state->camera_pitch < pitch_min) {
-        game_state->camera_pitch = pitch_min;
-    }
-    if (game_state->camera_pitch > pitch_max) {
-        game_state->camera_pitch = pitch_max;
-    }
+    camera_rig_look(&rig, input->mouse_movement);
 
-    // Calculate camera forward direction from angles
-    float yaw_rad = game_state->camera_yaw * ((float)M_PI / 180.0f);
-    float pitch_rad = game_state->camera_pitch * ((float)M_PI / 180.0f);
+    game_state->camera_yaw = rig.yaw;
+    game_state->camera_pitch = rig.pitch;
 
-    glm::vec3 camera_forward = glm::vec3(
-        cosf(pitch_rad) * sinf(yaw_rad),
-        sinf(pitch_rad),
-        cosf(pitch_rad) * cosf(yaw_rad));
+    float yaw_rad = rig.yaw * ((float)M_PI / 180.0f);
 
     glm::vec2 direction = glm::vec2(0.0f);
 
@@ -187,15 +232,9 @@ extern "C" GAME_ITERATE(game_iterate)
 
     glm::vec3 position = character_get_position(game_state->character_controller);
 
-    // Position camera behind and above the character
-    glm::vec3 camera_offset = {
-        -camera_forward.x * game_state->camera_distance,
-        -camera_forward.y * game_state->camera_distance,
-        -camera_forward.z * game_state->camera_distance
-    };
-
-    draw_list->camera.position = position + camera_offset;
-    draw_list->camera.target = position;
+    rig.target = position;
+    draw_list->camera = camera_rig_camera(&rig);
+    memcpy(draw_list->late_latch_data, &rig, sizeof(rig));
 
     Transform character_transform;
     character_transform.position = position;
@@ -203,11 +242,29 @@ extern "C" GAME_ITERATE(game_iterate)
     Transform world_transform;
 
     for (size_t i = 0; i < game_state->meshes_count - 1; i++) {
-        push_draw_mesh(draw_list, game_state->meshes[i], game_state->test_texture, world_transform);
+        push_draw_mesh(draw_list, game_state->meshes[i], game_state->test_material, world_transform);
     }
 
-    push_draw_mesh(draw_list, game_state->character_capsule_mesh, game_state->test_texture, character_transform);
+    push_draw_mesh(draw_list, game_state->character_capsule_mesh, game_state->test_material, character_transform);
+
+    if (input->toggle_debug_draw.pressed && input->toggle_debug_draw.half_transition_count > 0) {
+        game_state->debug_draw = !game_state->debug_draw;
+    }
+
+    if (game_state->debug_draw) {
+        physics_debug_draw(game_state->physics_world, game_state->character_controller, draw_list);
+    }
 
     // Reset transient arena
     game_state->transient_arena.clear();
 }
+
+extern "C" LATE_LATCH_CAMERA(late_latch_camera)
+{
+    CameraRig rig;
+    memcpy(&rig, late_latch_data, sizeof(rig));
+
+    camera_rig_look(&rig, mouse_delta);
+
+    return camera_rig_camera(&rig);
+}
@@ -1,5 +1,7 @@
 #include "physics.h"
 
+#include "debug_draw.h"
+
 #include <Jolt/Jolt.h>
 
 // Jolt includes
@@ -17,6 +19,7 @@
 #include <Jolt/Math/Vec3.h>
 #include <Jolt/Physics/Body/BodyActivationListener.h>
 #include <Jolt/Physics/Body/BodyCreationSettings.h>
+#include <Jolt/Physics/Body/BodyLock.h>
 #include <Jolt/Physics/Collision/BroadPhase/BroadPhase.h>
 #include <Jolt/Physics/Collision/NarrowPhaseQuery.h>
 #include <Jolt/Physics/Collision/ObjectLayer.h>
@@ -358,3 +361,72 @@ void update_physics_world(PhysicsWorld* physics_world, float dt, Arena& temp_are
     // FIXME: Handle error
     physics_world->physics_system.Update(dt, 1, &physics_world->temp_allocator, &physics_world->job_system);
 }
+
+#ifdef ALMOND_DEBUG_DRAW
+
+// Convex hulls are drawn face by face so shared edges appear twice, other
+// shapes fall back to their world space bounds
+static void debug_draw_body(DrawList* draw_list, const JPH::Body& body, uint32_t color)
+{
+    const JPH::Shape* shape = body.GetShape();
+
+    if (shape->GetSubType() != JPH::EShapeSubType::ConvexHull) {
+        JPH::AABox bounds = body.GetWorldSpaceBounds();
+        debug_draw_aabb(draw_list, to_glm(bounds.mMin), to_glm(bounds.mMax), color);
+        return;
+    }
+
+    auto* hull = (const JPH::ConvexHullShape*)shape;
+
+    uint32_t line_count = 0;
+    for (JPH::uint face = 0; face < hull->GetNumFaces(); face++) {
+        line_count += hull->GetNumVerticesInFace(face);
+    }
+
+    DebugVertex* vertices = debug_draw_lines(draw_list, line_count);
+    if (!vertices) {
+        return;
+    }
+
+    // Hull points are relative to the center of mass
+    JPH::RMat44 transform = body.GetCenterOfMassTransform();
+
+    for (JPH::uint face = 0; face < hull->GetNumFaces(); face++) {
+        JPH::uint count = hull->GetNumVerticesInFace(face);
+        const JPH::uint8* indices = hull->GetFaceVertices(face);
+
+        for (JPH::uint i = 0; i < count; i++) {
+            *vertices++ = { to_glm(JPH::Vec3(transform * hull->GetPoint(indices[i]))), color };
+            *vertices++ = { to_glm(JPH::Vec3(transform * hull->GetPoint(indices[(i + 1) % count]))), color };
+        }
+    }
+}
+
+void physics_debug_draw(PhysicsWorld* physics_world, CharacterController* character, DrawList* draw_list)
+{
+    JPH::PhysicsSystem& physics_system = physics_world->physics_system;
+
+    JPH::BodyIDVector bodies;
+    physics_system.GetBodies(bodies);
+
+    uint32_t static_color = debug_color(80, 220, 80);
+    uint32_t dynamic_color = debug_color(240, 160, 40);
+
+    for (JPH::BodyID id : bodies) {
+        JPH::BodyLockRead lock(physics_system.GetBodyLockInterfaceNoLock(), id);
+
+        if (lock.Succeeded()) {
+            const JPH::Body& body = lock.GetBody();
+            debug_draw_body(draw_list, body, body.IsStatic() ? static_color : dynamic_color);
+        }
+    }
+
+    if (character) {
+        auto* capsule = (const JPH::CapsuleShape*)character->character_virtual.GetShape();
+
+        debug_draw_capsule(draw_list, to_glm(character->character_virtual.GetPosition()),
+            capsule->GetHalfHeightOfCylinder(), capsule->GetRadius(), debug_color(80, 160, 255));
+    }
+}
+
+#endif
@@ -33,3 +33,10 @@ glm::vec3 character_get_position(CharacterController* character);
 void character_set_position(CharacterController* character, glm::vec3 position);
 bool character_is_grounded(CharacterController* character);
 void character_update(PhysicsWorld* physics_world, CharacterController* character, float dt, glm::vec3 gravity);
+
+#ifdef ALMOND_DEBUG_DRAW
+// Wireframes of every body and of the character, one line command per body
+void physics_debug_draw(PhysicsWorld* physics_world, CharacterController* character, DrawList* draw_list);
+#else
+inline void physics_debug_draw(PhysicsWorld*, CharacterController*, DrawList*) { }
+#endif
@@ -1,11 +1,29 @@
 #include "render_commands.h"
 
-void push_draw_mesh(DrawList* draw_list, MeshHandle mesh, TextureHandle texture, Transform transform)
+#include "../src/logger.h"
+
+void push_draw_mesh(DrawList* draw_list, MeshHandle mesh, MaterialHandle material, Transform transform)
+{
+    auto* cmd = (DrawMeshCommand*)draw_list_push(draw_list, DrawCommandType::DrawMesh, sizeof(DrawMeshCommand));
+    if (!cmd) {
+        log_err("Out of draw list memory");
+        return;
+    }
+
+    cmd->mesh = mesh;
+    cmd->material = material;
+    cmd->transform = transform;
+}
+
+void push_draw_mesh_matrix(DrawList* draw_list, MeshHandle mesh, MaterialHandle material, const glm::mat4& model_matrix)
 {
-    DrawCommand* cmd = &draw_list->commands[draw_list->count++];
+    auto* cmd = (DrawMeshMatrixCommand*)draw_list_push(draw_list, DrawCommandType::DrawMeshMatrix, sizeof(DrawMeshMatrixCommand));
+    if (!cmd) {
+        log_err("Out of draw list memory");
+        return;
+    }
 
-    cmd->type = DrawCommandType::DrawMesh;
-    cmd->as.draw_mesh.mesh = mesh;
-    cmd->as.draw_mesh.texture = texture;
-    cmd->as.draw_mesh.transform = transform;
+    cmd->mesh = mesh;
+    cmd->material = material;
+    cmd->model_matrix = model_matrix;
 }
@@ -2,5 +2,6 @@
 
 #include <almond.h>
 
-void push_draw_mesh(DrawList* draw_list, MeshHandle mesh, TextureHandle texture, Transform transform);
+void push_draw_mesh(DrawList* draw_list, MeshHandle mesh, MaterialHandle material, Transform transform);
+void push_draw_mesh_matrix(DrawList* draw_list, MeshHandle mesh, MaterialHandle material, const glm::mat4& model_matrix);
 // void push_draw_debug_collider(DrawList* draw_list, MeshHandle handle, Transform transform);
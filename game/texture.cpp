@@ -1,20 +1,229 @@
 #include "texture.h"
+#include "texture_compress.h"
+
+#include "../src/logger.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#define TEXTURE_CACHE_MAGIC 0x58455441 // "ATEX"
+#define TEXTURE_CACHE_VERSION 1
+
+// Cooked textures are cached next to their source as <name>.atex: this header
+// followed by every mip level, largest first, in the encoded format.
+struct TextureCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+    uint64_t data_size;
+};
+
+// Levels down to 1x1, largest first
+static uint32_t full_mip_count(uint32_t width, uint32_t height)
+{
+    uint32_t mip_count = 1;
+    for (uint32_t w = width, h = height; w > 1 || h > 1; mip_count++) {
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    return mip_count;
+}
+
+static bool read_texture_cache(const uint8_t* file, size_t file_size, TextureData* out_texture_data)
+{
+    if (file_size < sizeof(TextureCacheHeader)) {
+        return false;
+    }
+
+    TextureCacheHeader header;
+    memcpy(&header, file, sizeof(header));
+
+    if (header.magic != TEXTURE_CACHE_MAGIC || header.version != TEXTURE_CACHE_VERSION
+        || header.data_size != file_size - sizeof(header)) {
+        return false;
+    }
+
+    // Written by another build, cooked again
+    if (header.format > (uint32_t)TextureFormat::BC3) {
+        return false;
+    }
+
+    // A damaged header would have the renderer read levels that are not there
+    if (header.width == 0 || header.height == 0 || header.mip_count == 0
+        || header.mip_count > full_mip_count(header.width, header.height)) {
+        return false;
+    }
+
+    out_texture_data->format = (TextureFormat)header.format;
+    out_texture_data->width = header.width;
+    out_texture_data->height = header.height;
+    out_texture_data->mip_count = header.mip_count;
+    out_texture_data->data = file + sizeof(header);
+    out_texture_data->size = header.data_size;
+
+    return true;
+}
+
+static void write_texture_cache(const char* path, const TextureData* texture_data)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        log_warn("Could not write texture cache %s", path);
+        return;
+    }
+
+    TextureCacheHeader header = {
+        .magic = TEXTURE_CACHE_MAGIC,
+        .version = TEXTURE_CACHE_VERSION,
+        .format = (uint32_t)texture_data->format,
+        .width = texture_data->width,
+        .height = texture_data->height,
+        .mip_count = texture_data->mip_count,
+        .data_size = texture_data->size,
+    };
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(texture_data->data, texture_data->size, 1, file);
+    fclose(file);
+}
+
+// Builds the full mip chain on the CPU and block compresses every level, BC1
+// for opaque images and BC3 when any texel has alpha. The returned data is
+// malloc'd, it is NULL when memory ran out.
+static TextureData cook_texture(const uint8_t* rgba_data, uint32_t width, uint32_t height)
+{
+    TextureFormat format = TextureFormat::BC1;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        if (rgba_data[i * 4 + 3] != 255) {
+            format = TextureFormat::BC3;
+            break;
+        }
+    }
+
+    uint32_t mip_count = full_mip_count(width, height);
+    size_t size = 0;
+
+    for (uint32_t i = 0, w = width, h = height; i < mip_count; i++) {
+        size += texture_level_size(format, w, h);
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    auto* data = (uint8_t*)malloc(size);
+    auto* level = (uint8_t*)malloc((size_t)width * height * 4);
+    auto* next_level = (uint8_t*)malloc((size_t)width * height * 4);
+
+    if (!data || !level || !next_level) {
+        free(data);
+        free(level);
+        free(next_level);
+        return {};
+    }
+
+    memcpy(level, rgba_data, (size_t)width * height * 4);
+
+    uint8_t* dst = data;
+    uint32_t w = width, h = height;
+
+    for (uint32_t i = 0; i < mip_count; i++) {
+        compress_rgba(format, level, w, h, dst);
+        dst += texture_level_size(format, w, h);
+
+        if (i + 1 < mip_count) {
+            downsample_rgba(level, w, h, next_level);
+
+            uint8_t* swap = level;
+            level = next_level;
+            next_level = swap;
+
+            w = w > 1 ? w / 2 : 1;
+            h = h > 1 ? h / 2 : 1;
+        }
+    }
+
+    free(level);
+    free(next_level);
+
+    return {
+        .format = format,
+        .width = width,
+        .height = height,
+        .mip_count = mip_count,
+        .data = data,
+        .size = size,
+    };
+}
+
 TextureHandle load_texture(const char* name, Api* api)
 {
     char texture_path[512];
     snprintf(texture_path, sizeof(texture_path), "content/Textures/%s", name);
 
+    char cache_path[512];
+    snprintf(cache_path, sizeof(cache_path), "content/Textures/%s.atex", name);
+
+    bool compressed = api->is_texture_format_supported(TextureFormat::BC1)
+        && api->is_texture_format_supported(TextureFormat::BC3);
+
+    if (compressed) {
+        size_t cache_size;
+        auto* cache = static_cast<uint8_t*>(api->load_entire_file(cache_path, &cache_size));
+
+        // The renderer copies the data, the file can go right away
+        TextureData texture_data;
+        if (cache && read_texture_cache(cache, cache_size, &texture_data)) {
+            TextureHandle handle = api->create_texture_from_data(&texture_data);
+            api->free_file(cache);
+            return handle;
+        }
+
+        api->free_file(cache);
+    }
+
     size_t size;
     auto* buffer = static_cast<uint8_t*>(api->load_entire_file(texture_path, &size));
 
     int x, y, num_channels;
-    uint8_t* rgba_data = stbi_load_from_memory(buffer, (int)size, &x, &y, &num_channels, 4);
+    uint8_t* rgba_data = buffer ? stbi_load_from_memory(buffer, (int)size, &x, &y, &num_channels, 4) : NULL;
+
+    api->free_file(buffer);
+
+    if (!rgba_data) {
+        log_err("Could not load texture %s", texture_path);
+        return TextureHandle::invalid();
+    }
+
+    // Without block compression the renderer generates the mips
+    if (!compressed) {
+        TextureHandle handle = api->create_texture(rgba_data, x, y);
+        stbi_image_free(rgba_data);
+        return handle;
+    }
+
+    TextureData texture_data = cook_texture(rgba_data, (uint32_t)x, (uint32_t)y);
+
+    // The renderer can still take the uncompressed image
+    if (!texture_data.data) {
+        log_warn("Out of memory cooking %s, loading it uncompressed", texture_path);
+        TextureHandle handle = api->create_texture(rgba_data, x, y);
+        stbi_image_free(rgba_data);
+        return handle;
+    }
+
+    write_texture_cache(cache_path, &texture_data);
+
+    TextureHandle handle = api->create_texture_from_data(&texture_data);
+
+    free((void*)texture_data.data);
+    stbi_image_free(rgba_data);
 
-    return api->create_texture(rgba_data, x, y);
-}
\ No newline at end of file
+    return handle;
+}
@@ -0,0 +1,209 @@
+#include "texture_compress.h"
+
+#include <float.h>
+#include <string.h>
+
+void downsample_rgba(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+{
+    uint32_t dst_width = width > 1 ? width / 2 : 1;
+    uint32_t dst_height = height > 1 ? height / 2 : 1;
+
+    for (uint32_t y = 0; y < dst_height; y++) {
+        uint32_t y0 = y * 2 < height ? y * 2 : height - 1;
+        uint32_t y1 = y * 2 + 1 < height ? y * 2 + 1 : height - 1;
+
+        for (uint32_t x = 0; x < dst_width; x++) {
+            uint32_t x0 = x * 2 < width ? x * 2 : width - 1;
+            uint32_t x1 = x * 2 + 1 < width ? x * 2 + 1 : width - 1;
+
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t sum = src[(y0 * width + x0) * 4 + c] + src[(y0 * width + x1) * 4 + c]
+                    + src[(y1 * width + x0) * 4 + c] + src[(y1 * width + x1) * 4 + c];
+                dst[(y * dst_width + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+static uint16_t pack_565(glm::vec3 color)
+{
+    uint32_t r = (uint32_t)(glm::clamp(color.r, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+    uint32_t g = (uint32_t)(glm::clamp(color.g, 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+    uint32_t b = (uint32_t)(glm::clamp(color.b, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+
+    return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static glm::vec3 unpack_565(uint16_t color)
+{
+    uint32_t r = (color >> 11) & 31;
+    uint32_t g = (color >> 5) & 63;
+    uint32_t b = color & 31;
+
+    return glm::vec3((float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)));
+}
+
+// Fits the endpoints to the principal axis of the block colors and picks the
+// closest of the four palette entries for each texel. Always emits the four
+// color mode, which BC3 requires.
+static void compress_color_block(const uint8_t block[16][4], uint8_t* dst)
+{
+    glm::vec3 colors[16];
+    glm::vec3 mean(0.0f);
+
+    for (int i = 0; i < 16; i++) {
+        colors[i] = glm::vec3(block[i][0], block[i][1], block[i][2]);
+        mean += colors[i];
+    }
+    mean /= 16.0f;
+
+    float cov[6] = {};
+    for (int i = 0; i < 16; i++) {
+        glm::vec3 d = colors[i] - mean;
+        cov[0] += d.r * d.r;
+        cov[1] += d.r * d.g;
+        cov[2] += d.r * d.b;
+        cov[3] += d.g * d.g;
+        cov[4] += d.g * d.b;
+        cov[5] += d.b * d.b;
+    }
+
+    // A few power iterations are enough to find the dominant axis
+    glm::vec3 axis(1.0f, 1.0f, 1.0f);
+    for (int iteration = 0; iteration < 4; iteration++) {
+        axis = glm::vec3(
+            cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+            cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+            cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b);
+
+        float length = glm::length(axis);
+        if (length < 1e-6f) {
+            axis = glm::vec3(0.0f);
+            break;
+        }
+        axis /= length;
+    }
+
+    float min_t = 0.0f, max_t = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float t = glm::dot(colors[i] - mean, axis);
+        min_t = t < min_t ? t : min_t;
+        max_t = t > max_t ? t : max_t;
+    }
+
+    uint16_t color0 = pack_565(mean + axis * max_t);
+    uint16_t color1 = pack_565(mean + axis * min_t);
+
+    if (color0 < color1) {
+        uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    glm::vec3 palette[4];
+    palette[0] = unpack_565(color0);
+    palette[1] = unpack_565(color1);
+    palette[2] = (palette[0] * 2.0f + palette[1]) / 3.0f;
+    palette[3] = (palette[0] + palette[1] * 2.0f) / 3.0f;
+
+    uint32_t indices = 0;
+
+    // Equal endpoints select the three color mode on BC1, index 0 stays valid
+    if (color0 != color1) {
+        for (int i = 0; i < 16; i++) {
+            uint32_t best = 0;
+            float best_distance = FLT_MAX;
+
+            for (uint32_t p = 0; p < 4; p++) {
+                glm::vec3 d = colors[i] - palette[p];
+                float distance = glm::dot(d, d);
+
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = p;
+                }
+            }
+
+            indices |= best << (i * 2);
+        }
+    }
+
+    dst[0] = (uint8_t)(color0 & 0xFF);
+    dst[1] = (uint8_t)(color0 >> 8);
+    dst[2] = (uint8_t)(color1 & 0xFF);
+    dst[3] = (uint8_t)(color1 >> 8);
+    memcpy(dst + 4, &indices, 4);
+}
+
+// Eight interpolated alpha values between the block minimum and maximum
+static void compress_alpha_block(const uint8_t block[16][4], uint8_t* dst)
+{
+    uint8_t alpha0 = 0, alpha1 = 255;
+
+    for (int i = 0; i < 16; i++) {
+        alpha0 = block[i][3] > alpha0 ? block[i][3] : alpha0;
+        alpha1 = block[i][3] < alpha1 ? block[i][3] : alpha1;
+    }
+
+    uint64_t indices = 0;
+
+    if (alpha0 != alpha1) {
+        int palette[8];
+        palette[0] = alpha0;
+        palette[1] = alpha1;
+        for (int p = 1; p < 7; p++) {
+            palette[p + 1] = ((7 - p) * alpha0 + p * alpha1) / 7;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            uint64_t best = 0;
+            int best_distance = 256;
+
+            for (int p = 0; p < 8; p++) {
+                int distance = block[i][3] > palette[p] ? block[i][3] - palette[p] : palette[p] - block[i][3];
+
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = (uint64_t)p;
+                }
+            }
+
+            indices |= best << (i * 3);
+        }
+    }
+
+    dst[0] = alpha0;
+    dst[1] = alpha1;
+    for (int i = 0; i < 6; i++) {
+        dst[2 + i] = (uint8_t)(indices >> (i * 8));
+    }
+}
+
+void compress_rgba(TextureFormat format, const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst)
+{
+    size_t block_size = format == TextureFormat::BC1 ? 8 : 16;
+
+    for (uint32_t by = 0; by < height; by += 4) {
+        for (uint32_t bx = 0; bx < width; bx += 4) {
+            // Blocks hanging over the edge repeat the last row and column
+            uint8_t block[16][4];
+            for (uint32_t y = 0; y < 4; y++) {
+                uint32_t sy = by + y < height ? by + y : height - 1;
+
+                for (uint32_t x = 0; x < 4; x++) {
+                    uint32_t sx = bx + x < width ? bx + x : width - 1;
+                    memcpy(block[y * 4 + x], &src[(sy * width + sx) * 4], 4);
+                }
+            }
+
+            if (format == TextureFormat::BC3) {
+                compress_alpha_block(block, dst);
+                compress_color_block(block, dst + 8);
+            } else {
+                compress_color_block(block, dst);
+            }
+
+            dst += block_size;
+        }
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <almond.h>
+
+// Writes the level below an RGBA8 level of width x height, averaging 2x2
+// texels. Odd edges reuse the last texel.
+void downsample_rgba(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst);
+
+// Encodes an RGBA8 image into BC1 (format BC1) or BC3 (format BC3) blocks.
+// dst must hold texture_level_size(format, width, height) bytes.
+void compress_rgba(TextureFormat format, const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst);
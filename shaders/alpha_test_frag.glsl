@@ -0,0 +1,21 @@
+#version 450
+
+layout (location = 0) in vec2 vUV;
+layout (location = 1) flat in uint vTextureLayer;
+layout (location = 2) flat in float vAlphaCutoff;
+
+layout (location = 0) out vec4 FragColor;
+
+layout (set = 2, binding = 0) uniform sampler2DArray uTextures;
+
+// Kept apart from frag.glsl, a discard there would disable early depth
+// testing for every opaque draw
+void main() {
+    vec4 color = texture(uTextures, vec3(vUV, vTextureLayer));
+
+    if (color.a < vAlphaCutoff) {
+        discard;
+    }
+
+    FragColor = color;
+}
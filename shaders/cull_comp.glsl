@@ -0,0 +1,68 @@
+#version 450
+
+layout (local_size_x = 64) in;
+
+struct DrawData {
+    mat4 model;
+    uint material_index;
+    uint mesh_index;
+    uint batch_index;
+    uint padding;
+};
+
+// Matches SDL_GPUIndexedIndirectDrawCommand
+struct IndexedIndirectCommand {
+    uint num_indices;
+    uint num_instances;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+// Local space bounding sphere of every mesh slot, center and radius
+layout(std430, set = 0, binding = 1) readonly buffer MeshBoundsBuffer {
+    vec4 mesh_bounds[];
+};
+
+layout(std430, set = 1, binding = 0) writeonly buffer CulledDrawDataBuffer {
+    DrawData culled_draws[];
+};
+
+layout(std430, set = 1, binding = 1) buffer IndirectBuffer {
+    IndexedIndirectCommand commands[];
+};
+
+layout(std140, set = 2, binding = 0) uniform CullUniforms {
+    vec4 planes[6];
+    uint first_draw;
+    uint draw_count;
+};
+
+// One invocation per draw. Visible draws are appended to their batch, which
+// the CPU uploaded with no instances and first_instance at the batch start.
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= draw_count) {
+        return;
+    }
+
+    DrawData draw = draws[first_draw + i];
+    vec4 bounds = mesh_bounds[draw.mesh_index];
+
+    vec3 center = (draw.model * vec4(bounds.xyz, 1.0)).xyz;
+    float scale = max(length(draw.model[0].xyz), max(length(draw.model[1].xyz), length(draw.model[2].xyz)));
+    float radius = bounds.w * scale;
+
+    for (int p = 0; p < 6; p++) {
+        if (dot(planes[p].xyz, center) + planes[p].w < -radius) {
+            return;
+        }
+    }
+
+    uint slot = atomicAdd(commands[draw.batch_index].num_instances, 1);
+    culled_draws[commands[draw.batch_index].first_instance + slot] = draw;
+}
@@ -0,0 +1,9 @@
+#version 450
+
+layout (location = 0) in vec4 vColor;
+
+layout (location = 0) out vec4 FragColor;
+
+void main() {
+    FragColor = vColor;
+}
@@ -0,0 +1,16 @@
+#version 450
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec4 aColor;
+
+layout (location = 0) out vec4 vColor;
+
+layout(std140, set = 1, binding = 0) uniform VertexUniforms {
+    mat4 proj_view;
+};
+
+// Debug lines are already in world space
+void main() {
+    vColor = aColor;
+    gl_Position = proj_view * vec4(aPos, 1.0);
+}
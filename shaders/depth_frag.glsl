@@ -0,0 +1,5 @@
+#version 450
+
+// Depth only, nothing is written to the color target
+void main() {
+}
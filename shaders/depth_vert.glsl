@@ -0,0 +1,23 @@
+#version 450
+
+layout (location = 0) in vec3 aPos;
+
+struct DrawData {
+    mat4 model;
+    uint material_index;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+layout(std140, set = 1, binding = 0) uniform VertexUniforms {
+    mat4 proj_view;
+};
+
+// Computed exactly like vert.glsl so the color pass can test EQUAL
+invariant gl_Position;
+
+void main() {
+    gl_Position = proj_view * draws[gl_InstanceIndex].model * vec4(aPos, 1.0);
+}
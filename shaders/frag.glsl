@@ -1,11 +1,12 @@
 #version 450
 
 layout (location = 0) in vec2 vUV;
+layout (location = 1) flat in uint vTextureLayer;
 
 layout (location = 0) out vec4 FragColor;
 
-layout (set = 2, binding = 0) uniform sampler2D uTexture;
+layout (set = 2, binding = 0) uniform sampler2DArray uTextures;
 
 void main() {
-    FragColor = texture(uTexture, vUV);
+    FragColor = texture(uTextures, vec3(vUV, vTextureLayer));
 }
@@ -0,0 +1,8 @@
+#version 450
+
+layout (location = 0) out vec4 FragColor;
+
+// Blended additively, a pixel shaded 8 times saturates
+void main() {
+    FragColor = vec4(0.125, 0.0625, 0.03125, 1.0);
+}
@@ -4,13 +4,42 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aUV;
 
 layout (location = 0) out vec2 vUV;
+layout (location = 1) flat out uint vTextureLayer;
+layout (location = 2) flat out float vAlphaCutoff;
+
+// Must match depth_vert.glsl bit for bit, the color pass tests EQUAL against
+// the depth it wrote
+invariant gl_Position;
+
+struct DrawData {
+    mat4 model;
+    uint material_index;
+};
+
+struct MaterialData {
+    uint texture_layer;
+    uint flags;
+    float alpha_cutoff;
+    uint padding;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer MaterialDataBuffer {
+    MaterialData materials[];
+};
 
 layout(std140, set = 1, binding = 0) uniform VertexUniforms {
     mat4 proj_view;
-    mat4 model;
 };
 
 void main() {
+    MaterialData material = materials[draws[gl_InstanceIndex].material_index];
+
     vUV = aUV;
-    gl_Position = proj_view * model * vec4(aPos, 1.0);
+    vTextureLayer = material.texture_layer;
+    vAlphaCutoff = material.alpha_cutoff;
+    gl_Position = proj_view * draws[gl_InstanceIndex].model * vec4(aPos, 1.0);
 }
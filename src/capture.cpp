@@ -0,0 +1,266 @@
+#include "capture.h"
+
+#include "logger.h"
+
+#include <SDL3/SDL_iostream.h>
+
+static const uint8_t capture_padding[CAPTURE_ALIGNMENT] = {};
+
+static size_t capture_padding_size(size_t size)
+{
+    return (CAPTURE_ALIGNMENT - size % CAPTURE_ALIGNMENT) % CAPTURE_ALIGNMENT;
+}
+
+bool capture_open(Capture* capture, const char* path)
+{
+    SDL_zerop(capture);
+
+    capture->lock = SDL_CreateMutex();
+    if (!capture->lock) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    capture->file = fopen(path, "wb");
+    if (!capture->file) {
+        log_err("Could not open capture file %s", path);
+        return false;
+    }
+
+    CaptureFileHeader header = {
+        .magic = CAPTURE_MAGIC,
+        .version = CAPTURE_VERSION,
+    };
+
+    fwrite(&header, sizeof(header), 1, capture->file);
+    capture->bytes = sizeof(header);
+
+    log_info("Capturing to %s", path);
+
+    return true;
+}
+
+void capture_close(Capture* capture)
+{
+    if (!capture->file) {
+        return;
+    }
+
+    fclose(capture->file);
+    capture->file = NULL;
+
+    log_info("Captured %llu frames, %.1f MB", (unsigned long long)capture->frames, (double)capture->bytes / (1024.0 * 1024.0));
+}
+
+// The payload is given in parts so large resource data is written straight
+// from the caller's memory
+static void write_record(Capture* capture, CaptureRecordType type, const void** parts, const size_t* sizes, size_t count)
+{
+    size_t size = 0;
+    for (size_t i = 0; i < count; i++) {
+        size += sizes[i];
+    }
+
+    CaptureRecordHeader header = {
+        .type = (Uint32)type,
+        .size = (Uint32)size,
+    };
+
+    SDL_LockMutex(capture->lock);
+
+    fwrite(&header, sizeof(header), 1, capture->file);
+
+    for (size_t i = 0; i < count; i++) {
+        if (sizes[i] > 0) {
+            fwrite(parts[i], sizes[i], 1, capture->file);
+        }
+    }
+
+    size_t padding = capture_padding_size(size);
+    fwrite(capture_padding, padding, 1, capture->file);
+
+    capture->bytes += sizeof(header) + size + padding;
+
+    if (type == CAPTURE_RECORD_FRAME) {
+        capture->frames++;
+    }
+
+    SDL_UnlockMutex(capture->lock);
+}
+
+void capture_mesh(Capture* capture, MeshHandle handle, const MeshData* mesh_data)
+{
+    CaptureMesh mesh = {
+        .handle = handle.value,
+        .vertices_count = (Uint32)mesh_data->vertices_count,
+        .indices_count = (Uint32)mesh_data->indices_count,
+    };
+
+    const void* parts[] = { &mesh, mesh_data->vertices, mesh_data->indices };
+    size_t sizes[] = { sizeof(mesh), mesh_data->vertices_count * sizeof(Vertex), mesh_data->indices_count * sizeof(uint16_t) };
+
+    write_record(capture, CAPTURE_RECORD_MESH, parts, sizes, 3);
+}
+
+void capture_texture(Capture* capture, TextureHandle handle, const TextureData* texture_data)
+{
+    CaptureTexture texture = {
+        .handle = handle.value,
+        .format = (Uint32)texture_data->format,
+        .width = texture_data->width,
+        .height = texture_data->height,
+        .mip_count = texture_data->mip_count,
+    };
+
+    const void* parts[] = { &texture, texture_data->data };
+    size_t sizes[] = { sizeof(texture), texture_data->size };
+
+    write_record(capture, CAPTURE_RECORD_TEXTURE, parts, sizes, 2);
+}
+
+void capture_material(Capture* capture, MaterialHandle handle, TextureHandle albedo, MaterialFlags flags)
+{
+    CaptureMaterial material = {
+        .handle = handle.value,
+        .albedo = albedo.value,
+        .flags = (Uint32)flags,
+    };
+
+    const void* parts[] = { &material };
+    size_t sizes[] = { sizeof(material) };
+
+    write_record(capture, CAPTURE_RECORD_MATERIAL, parts, sizes, 1);
+}
+
+void capture_destroy_mesh(Capture* capture, MeshHandle handle)
+{
+    CaptureDestroy destroy = { .handle = handle.value };
+
+    const void* parts[] = { &destroy };
+    size_t sizes[] = { sizeof(destroy) };
+
+    write_record(capture, CAPTURE_RECORD_DESTROY_MESH, parts, sizes, 1);
+}
+
+void capture_destroy_texture(Capture* capture, TextureHandle handle)
+{
+    CaptureDestroy destroy = { .handle = handle.value };
+
+    const void* parts[] = { &destroy };
+    size_t sizes[] = { sizeof(destroy) };
+
+    write_record(capture, CAPTURE_RECORD_DESTROY_TEXTURE, parts, sizes, 1);
+}
+
+void capture_frame(Capture* capture, const DrawList* draw_list)
+{
+    CaptureFrame frame = {
+        .clear_color = draw_list->clear_color,
+        .camera = draw_list->camera,
+        .command_count = (Uint32)draw_list->count,
+    };
+
+    // The frame plus one part per page in use, every page holds whole commands
+    size_t page_count = 0;
+
+    for (const DrawListPage* page = draw_list->count > 0 ? draw_list->first_page : NULL; page; page = page->next) {
+        page_count++;
+
+        if (page == draw_list->current_page) {
+            break;
+        }
+    }
+
+    auto** parts = (const void**)SDL_malloc((page_count + 1) * sizeof(void*));
+    auto* sizes = (size_t*)SDL_malloc((page_count + 1) * sizeof(size_t));
+
+    if (!parts || !sizes) {
+        log_err("Out of memory");
+        SDL_free(parts);
+        SDL_free(sizes);
+        return;
+    }
+
+    size_t count = 0;
+
+    parts[count] = &frame;
+    sizes[count] = sizeof(frame);
+    count++;
+
+    for (const DrawListPage* page = draw_list->count > 0 ? draw_list->first_page : NULL; count <= page_count; page = page->next) {
+        parts[count] = page + 1;
+        sizes[count] = page->used;
+        count++;
+    }
+
+    write_record(capture, CAPTURE_RECORD_FRAME, parts, sizes, count);
+
+    SDL_free(parts);
+    SDL_free(sizes);
+}
+
+bool capture_reader_open(CaptureReader* reader, const char* path)
+{
+    SDL_zerop(reader);
+
+    reader->data = SDL_LoadFile(path, &reader->size);
+    if (!reader->data) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    CaptureFileHeader header;
+    if (reader->size < sizeof(header)) {
+        log_err("%s is not a capture", path);
+        return false;
+    }
+
+    SDL_memcpy(&header, reader->data, sizeof(header));
+
+    if (header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION) {
+        log_err("%s is not a version %u capture", path, CAPTURE_VERSION);
+        return false;
+    }
+
+    reader->offset = sizeof(header);
+
+    return true;
+}
+
+void capture_reader_close(CaptureReader* reader)
+{
+    SDL_free(reader->data);
+    reader->data = NULL;
+}
+
+void capture_reader_rewind(CaptureReader* reader)
+{
+    reader->offset = sizeof(CaptureFileHeader);
+}
+
+bool capture_reader_next(CaptureReader* reader, CaptureRecordType* out_type, const uint8_t** out_payload, Uint32* out_size)
+{
+    CaptureRecordHeader header;
+
+    if (reader->size - reader->offset < sizeof(header)) {
+        return false;
+    }
+
+    auto* bytes = (const uint8_t*)reader->data;
+    SDL_memcpy(&header, bytes + reader->offset, sizeof(header));
+
+    size_t record_size = sizeof(header) + header.size + capture_padding_size(header.size);
+
+    if (reader->size - reader->offset < record_size) {
+        log_warn("Capture is truncated");
+        return false;
+    }
+
+    *out_type = (CaptureRecordType)header.type;
+    *out_payload = bytes + reader->offset + sizeof(header);
+    *out_size = header.size;
+
+    reader->offset += record_size;
+
+    return true;
+}
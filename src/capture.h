@@ -0,0 +1,101 @@
+#pragma once
+
+#include "public/almond.h"
+
+#include <SDL3/SDL_mutex.h>
+#include <stdio.h>
+
+// A trace is a file header followed by records: a record header and a payload
+// padded to CAPTURE_ALIGNMENT. Resource records come before the first frame
+// that references them. Handles are stored as the game saw them, a replay
+// maps them to the handles it creates. Traces are only meant to be replayed
+// on the machine and build that captured them.
+#define CAPTURE_MAGIC 0x50414341 // "ACAP"
+#define CAPTURE_VERSION 2
+#define CAPTURE_ALIGNMENT 8
+
+typedef enum {
+    CAPTURE_RECORD_MESH = 1,
+    CAPTURE_RECORD_TEXTURE,
+    CAPTURE_RECORD_DESTROY_MESH,
+    CAPTURE_RECORD_DESTROY_TEXTURE,
+    CAPTURE_RECORD_FRAME,
+    CAPTURE_RECORD_MATERIAL,
+} CaptureRecordType;
+
+typedef struct {
+    Uint32 magic;
+    Uint32 version;
+} CaptureFileHeader;
+
+typedef struct {
+    Uint32 type;
+    // Payload size, padding excluded
+    Uint32 size;
+} CaptureRecordHeader;
+
+// Followed by the vertices and then the indices
+typedef struct {
+    Uint32 handle;
+    Uint32 vertices_count;
+    Uint32 indices_count;
+} CaptureMesh;
+
+// Followed by the texture data. A mip_count of 0 is an RGBA texture whose
+// mips the renderer generates.
+typedef struct {
+    Uint32 handle;
+    Uint32 format;
+    Uint32 width;
+    Uint32 height;
+    Uint32 mip_count;
+} CaptureTexture;
+
+typedef struct {
+    Uint32 handle;
+    Uint32 albedo;
+    Uint32 flags;
+} CaptureMaterial;
+
+typedef struct {
+    Uint32 handle;
+} CaptureDestroy;
+
+// Followed by the draw list command stream, its pages concatenated
+typedef struct {
+    glm::vec4 clear_color;
+    Camera camera;
+    Uint32 command_count;
+} CaptureFrame;
+
+typedef struct {
+    FILE* file;
+    // Resources are created on the game thread, frames recorded on the render thread
+    SDL_Mutex* lock;
+    Uint64 frames;
+    Uint64 bytes;
+} Capture;
+
+bool capture_open(Capture* capture, const char* path);
+void capture_close(Capture* capture);
+
+void capture_mesh(Capture* capture, MeshHandle handle, const MeshData* mesh_data);
+void capture_texture(Capture* capture, TextureHandle handle, const TextureData* texture_data);
+void capture_material(Capture* capture, MaterialHandle handle, TextureHandle albedo, MaterialFlags flags);
+void capture_destroy_mesh(Capture* capture, MeshHandle handle);
+void capture_destroy_texture(Capture* capture, TextureHandle handle);
+void capture_frame(Capture* capture, const DrawList* draw_list);
+
+// Walks the records of a trace loaded in memory
+typedef struct {
+    void* data;
+    size_t size;
+    size_t offset;
+} CaptureReader;
+
+bool capture_reader_open(CaptureReader* reader, const char* path);
+void capture_reader_close(CaptureReader* reader);
+void capture_reader_rewind(CaptureReader* reader);
+
+// Returns false once every record was read or the trace is truncated
+bool capture_reader_next(CaptureReader* reader, CaptureRecordType* out_type, const uint8_t** out_payload, Uint32* out_size);
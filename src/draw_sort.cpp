@@ -0,0 +1,112 @@
+#include "draw_sort.h"
+
+Uint64 draw_sort_key(SortPass pass, Uint32 pipeline, Uint32 material, Uint32 mesh, Uint32 depth)
+{
+    return ((Uint64)(pass & 0x3) << SORT_KEY_PASS_SHIFT)
+        | ((Uint64)(pipeline & 0x3F) << SORT_KEY_PIPELINE_SHIFT)
+        | ((Uint64)(material & 0xFFFF) << SORT_KEY_MATERIAL_SHIFT)
+        | ((Uint64)(mesh & 0xFFFF) << SORT_KEY_MESH_SHIFT)
+        | (Uint64)(depth & SORT_KEY_DEPTH_MAX);
+}
+
+bool draw_sort_reserve(DrawSortBuffers* buffers, size_t count)
+{
+    if (count <= buffers->capacity) {
+        return true;
+    }
+
+    size_t capacity = buffers->capacity == 0 ? 1024 : buffers->capacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    Uint64* keys = (Uint64*)SDL_realloc(buffers->keys, capacity * sizeof(Uint64));
+    if (!keys) {
+        return false;
+    }
+    buffers->keys = keys;
+
+    Uint32* indices = (Uint32*)SDL_realloc(buffers->indices, capacity * sizeof(Uint32));
+    if (!indices) {
+        return false;
+    }
+    buffers->indices = indices;
+
+    Uint64* scratch_keys = (Uint64*)SDL_realloc(buffers->scratch_keys, capacity * sizeof(Uint64));
+    if (!scratch_keys) {
+        return false;
+    }
+    buffers->scratch_keys = scratch_keys;
+
+    Uint32* scratch_indices = (Uint32*)SDL_realloc(buffers->scratch_indices, capacity * sizeof(Uint32));
+    if (!scratch_indices) {
+        return false;
+    }
+    buffers->scratch_indices = scratch_indices;
+
+    buffers->capacity = capacity;
+
+    return true;
+}
+
+void draw_sort(DrawSortBuffers* buffers)
+{
+    size_t count = buffers->count;
+
+    if (count < 2) {
+        return;
+    }
+
+    // One pass over the keys builds the histograms of all eight digits
+    Uint32 histograms[8][256] = {};
+
+    for (size_t i = 0; i < count; i++) {
+        Uint64 key = buffers->keys[i];
+
+        for (int digit = 0; digit < 8; digit++) {
+            histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+        }
+    }
+
+    Uint64* keys = buffers->keys;
+    Uint32* indices = buffers->indices;
+    Uint64* scratch_keys = buffers->scratch_keys;
+    Uint32* scratch_indices = buffers->scratch_indices;
+
+    for (int digit = 0; digit < 8; digit++) {
+        Uint32* histogram = histograms[digit];
+        int shift = digit * 8;
+
+        // Every key shares this byte, the pass would not move anything
+        if (histogram[(keys[0] >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        Uint32 offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++) {
+            Uint32 bucket_count = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucket_count;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            Uint32 destination = histogram[(keys[i] >> shift) & 0xFF]++;
+            scratch_keys[destination] = keys[i];
+            scratch_indices[destination] = indices[i];
+        }
+
+        Uint64* temp_keys = keys;
+        keys = scratch_keys;
+        scratch_keys = temp_keys;
+
+        Uint32* temp_indices = indices;
+        indices = scratch_indices;
+        scratch_indices = temp_indices;
+    }
+
+    // Swap buffer ownership instead of copying back when the result ended up in scratch
+    buffers->keys = keys;
+    buffers->indices = indices;
+    buffers->scratch_keys = scratch_keys;
+    buffers->scratch_indices = scratch_indices;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+// Draw sort key layout, most significant bits first:
+//   63..62  pass
+//   61..56  pipeline
+//   55..40  material
+//   39..24  mesh
+//   23..0   depth bucket
+// Sorting by key groups draws by state so bindings change as rarely as
+// possible, and orders draws sharing all state front to back.
+#define SORT_KEY_PASS_SHIFT 62
+#define SORT_KEY_PIPELINE_SHIFT 56
+#define SORT_KEY_MATERIAL_SHIFT 40
+#define SORT_KEY_MESH_SHIFT 24
+
+#define SORT_KEY_DEPTH_BITS 24
+#define SORT_KEY_DEPTH_MAX ((1u << SORT_KEY_DEPTH_BITS) - 1)
+
+typedef enum {
+    SORT_PASS_OPAQUE = 0,
+} SortPass;
+
+typedef struct {
+    Uint64* keys;
+    Uint32* indices;
+    Uint64* scratch_keys;
+    Uint32* scratch_indices;
+    size_t count;
+    size_t capacity;
+} DrawSortBuffers;
+
+Uint64 draw_sort_key(SortPass pass, Uint32 pipeline, Uint32 material, Uint32 mesh, Uint32 depth);
+
+bool draw_sort_reserve(DrawSortBuffers* buffers, size_t count);
+
+// Sorts buffers->keys ascending and applies the same permutation to
+// buffers->indices with an LSD radix sort over the key bytes. Bytes that are
+// identical across every key are skipped.
+void draw_sort(DrawSortBuffers* buffers);
@@ -0,0 +1,107 @@
+#include "frame_pacer.h"
+#include "logger.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_timer.h>
+
+// Sleeps overshoot by up to the scheduler granularity, the last stretch
+// before the deadline is busy-waited instead
+#define FRAME_PACER_SPIN_MS 2
+
+static double ticks_to_ms(FramePacer* pacer, Uint64 ticks)
+{
+    return (double)ticks * 1000.0 / (double)pacer->frequency;
+}
+
+void frame_pacer_init(FramePacer* pacer, float fps_cap)
+{
+    SDL_zerop(pacer);
+
+    pacer->frequency = SDL_GetPerformanceFrequency();
+    pacer->target_ticks = fps_cap > 0.0f ? (Uint64)((double)pacer->frequency / fps_cap) : 0;
+    pacer->spin_ticks = pacer->frequency * FRAME_PACER_SPIN_MS / 1000;
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    pacer->frame_start = now;
+    pacer->last_present = now;
+    pacer->report_start = now;
+}
+
+float frame_pacer_begin_frame(FramePacer* pacer)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    float dt = (float)((double)(now - pacer->frame_start) / (double)pacer->frequency);
+    pacer->frame_start = now;
+
+    return dt;
+}
+
+static void frame_pacer_report(FramePacer* pacer, Uint64 now)
+{
+    FrameTimings* timings = &pacer->last;
+    FrameTimings* sum = &pacer->report_sum;
+    FrameTimings* max = &pacer->report_max;
+
+    sum->cpu_ms += timings->cpu_ms;
+    sum->gpu_wait_ms += timings->gpu_wait_ms;
+    sum->present_interval_ms += timings->present_interval_ms;
+    sum->jitter_ms += timings->jitter_ms;
+
+    max->cpu_ms = SDL_max(max->cpu_ms, timings->cpu_ms);
+    max->gpu_wait_ms = SDL_max(max->gpu_wait_ms, timings->gpu_wait_ms);
+    max->present_interval_ms = SDL_max(max->present_interval_ms, timings->present_interval_ms);
+    max->jitter_ms = SDL_max(max->jitter_ms, timings->jitter_ms);
+
+    pacer->report_frames++;
+
+    if (now - pacer->report_start < pacer->frequency) {
+        return;
+    }
+
+    double frames = (double)pacer->report_frames;
+
+    log_info("%u fps | cpu %.2f ms (max %.2f) | gpu wait %.2f ms (max %.2f) | present %.2f ms (max %.2f) | jitter %.2f ms (max %.2f)",
+        pacer->report_frames,
+        sum->cpu_ms / frames, max->cpu_ms,
+        sum->gpu_wait_ms / frames, max->gpu_wait_ms,
+        sum->present_interval_ms / frames, max->present_interval_ms,
+        sum->jitter_ms / frames, max->jitter_ms);
+
+    pacer->report_start = now;
+    pacer->report_frames = 0;
+    SDL_zero(pacer->report_sum);
+    SDL_zero(pacer->report_max);
+}
+
+void frame_pacer_end_frame(FramePacer* pacer, Uint64 gpu_wait_ticks)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    double interval_ms = ticks_to_ms(pacer, now - pacer->last_present);
+
+    pacer->last.gpu_wait_ms = ticks_to_ms(pacer, gpu_wait_ticks);
+    pacer->last.cpu_ms = ticks_to_ms(pacer, now - pacer->frame_start) - pacer->last.gpu_wait_ms;
+    pacer->last.present_interval_ms = interval_ms;
+    pacer->last.jitter_ms = SDL_fabs(interval_ms - pacer->last_interval_ms);
+
+    pacer->last_present = now;
+    pacer->last_interval_ms = interval_ms;
+
+    frame_pacer_report(pacer, now);
+
+    if (pacer->target_ticks == 0) {
+        return;
+    }
+
+    Uint64 deadline = pacer->frame_start + pacer->target_ticks;
+
+    now = SDL_GetPerformanceCounter();
+    if (now + pacer->spin_ticks < deadline) {
+        Uint64 sleep_ticks = deadline - pacer->spin_ticks - now;
+        SDL_DelayNS(sleep_ticks * SDL_NS_PER_SECOND / pacer->frequency);
+    }
+
+    while (SDL_GetPerformanceCounter() < deadline) {
+        SDL_CPUPauseInstruction();
+    }
+}
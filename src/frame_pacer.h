@@ -0,0 +1,43 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+// Timings of one frame, in milliseconds
+typedef struct {
+    // Frame start to submit, excluding the swapchain wait
+    double cpu_ms;
+    // Blocked acquiring the swapchain, waiting on the GPU or presentation
+    double gpu_wait_ms;
+    // Submit to submit
+    double present_interval_ms;
+    // Change of present_interval_ms from the previous frame
+    double jitter_ms;
+} FrameTimings;
+
+typedef struct {
+    Uint64 frequency;
+    Uint64 target_ticks; // 0 when uncapped
+    Uint64 spin_ticks;
+
+    Uint64 frame_start;
+    Uint64 last_present;
+    double last_interval_ms;
+
+    FrameTimings last;
+
+    Uint64 report_start;
+    Uint32 report_frames;
+    FrameTimings report_sum;
+    FrameTimings report_max;
+} FramePacer;
+
+// A cap of 0 leaves the frame rate to the present mode
+void frame_pacer_init(FramePacer* pacer, float fps_cap);
+
+// Returns the seconds elapsed since the previous frame began, measured with
+// the performance counter
+float frame_pacer_begin_frame(FramePacer* pacer);
+
+// Records the timings of the frame just submitted and logs a summary once per
+// second, then sleeps and finally spins until the frame budget is used up.
+void frame_pacer_end_frame(FramePacer* pacer, Uint64 gpu_wait_ticks);
@@ -0,0 +1,73 @@
+#include "frame_queue.h"
+
+#include "logger.h"
+
+static ALLOCATE_DRAW_LIST_PAGE(allocate_draw_list_page)
+{
+    auto* page = (DrawListPage*)SDL_malloc(sizeof(DrawListPage) + min_capacity);
+    if (!page) {
+        return NULL;
+    }
+
+    page->capacity = min_capacity;
+
+    return page;
+}
+
+bool frame_queue_init(FrameQueue* queue)
+{
+    SDL_zerop(queue);
+
+    // Pages are allocated as the lists first grow and kept for the whole run
+    for (size_t i = 0; i < FRAME_QUEUE_SIZE; i++) {
+        queue->draw_lists[i].allocate_page = allocate_draw_list_page;
+    }
+
+    queue->free_lists = SDL_CreateSemaphore(FRAME_QUEUE_SIZE);
+    queue->ready_lists = SDL_CreateSemaphore(0);
+
+    if (!queue->free_lists || !queue->ready_lists) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+DrawList* frame_queue_begin_write(FrameQueue* queue)
+{
+    SDL_WaitSemaphore(queue->free_lists);
+
+    DrawList* draw_list = &queue->draw_lists[queue->write_index];
+    draw_list_reset(draw_list);
+
+    return draw_list;
+}
+
+void frame_queue_end_write(FrameQueue* queue)
+{
+    queue->write_index = (queue->write_index + 1) % FRAME_QUEUE_SIZE;
+
+    // Semaphores order the writes to the list before the reader sees it
+    SDL_SignalSemaphore(queue->ready_lists);
+}
+
+DrawList* frame_queue_begin_read(FrameQueue* queue, Sint32 timeout_ms)
+{
+    if (!SDL_WaitSemaphoreTimeout(queue->ready_lists, timeout_ms)) {
+        return NULL;
+    }
+
+    return &queue->draw_lists[queue->read_index];
+}
+
+void frame_queue_end_read(FrameQueue* queue)
+{
+    queue->read_index = (queue->read_index + 1) % FRAME_QUEUE_SIZE;
+    SDL_SignalSemaphore(queue->free_lists);
+}
+
+void frame_queue_release_writer(FrameQueue* queue)
+{
+    SDL_SignalSemaphore(queue->free_lists);
+}
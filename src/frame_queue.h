@@ -0,0 +1,34 @@
+#pragma once
+
+#include "public/almond.h"
+
+#include <SDL3/SDL_mutex.h>
+
+#define FRAME_QUEUE_SIZE 2
+
+// Bounded handoff of draw lists from the game thread to the render thread.
+// The game fills one list while the renderer plays the other; once both are
+// in use the producer blocks, so the game runs at most one frame ahead.
+typedef struct {
+    DrawList draw_lists[FRAME_QUEUE_SIZE];
+
+    SDL_Semaphore* free_lists;
+    SDL_Semaphore* ready_lists;
+
+    // Each index is only touched by its own side
+    Uint32 write_index;
+    Uint32 read_index;
+} FrameQueue;
+
+bool frame_queue_init(FrameQueue* queue);
+
+// Game thread: waits for a list the renderer is done with
+DrawList* frame_queue_begin_write(FrameQueue* queue);
+void frame_queue_end_write(FrameQueue* queue);
+
+// Render thread: waits for the next list the game finished, NULL on timeout
+DrawList* frame_queue_begin_read(FrameQueue* queue, Sint32 timeout_ms);
+void frame_queue_end_read(FrameQueue* queue);
+
+// Wakes a producer blocked in frame_queue_begin_write, used on shutdown
+void frame_queue_release_writer(FrameQueue* queue);
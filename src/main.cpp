@@ -1,7 +1,11 @@
+#include "capture.h"
 #include "file_watcher.h"
+#include "frame_queue.h"
+#include "frame_pacer.h"
 #include "logger.h"
 #include "public/almond.h"
 #include "renderer.h"
+#include "renderer_null.h"
 
 #include <SDL3/SDL.h>
 #include <SDL3/SDL_gpu.h>
@@ -12,29 +16,404 @@
 #include <sys/mman.h>
 
 Renderer renderer;
+NullRenderer null_renderer;
+Capture capture;
 
 #define Megabytes(n) (n * 1024 * 1024)
 #define Gigabytes(n) (n * 1024 * 1024 * 1024)
 
+typedef enum {
+    PENDING_DESTROY_MESH,
+    PENDING_DESTROY_TEXTURE,
+} PendingDestroyType;
+
+typedef struct {
+    PendingDestroyType type;
+    Uint32 handle;
+    // lists_begun when it was issued
+    Uint64 list;
+} PendingDestroy;
+
+// Destroys the game issues while it builds a draw list are held until that
+// list has been played. Both it and the list playing meanwhile may still draw
+// the handle, which the renderer would otherwise already see as stale.
+typedef struct {
+    SDL_Mutex* lock;
+    PendingDestroy* destroys;
+    size_t count;
+    size_t capacity;
+
+    Uint64 lists_begun;
+    Uint64 lists_played;
+
+    bool headless;
+} PendingDestroys;
+
+PendingDestroys pending_destroys;
+
+// Recorded here rather than when the game destroys, so a trace has the
+// destroy after the frames that still draw the handle
+static void destroy_now(PendingDestroyType type, Uint32 handle)
+{
+    if (type == PENDING_DESTROY_MESH) {
+        if (pending_destroys.headless) {
+            null_renderer_destroy_mesh(&null_renderer, MeshHandle(handle));
+        } else {
+            renderer_destroy_mesh(&renderer, MeshHandle(handle));
+        }
+
+        if (capture.file) {
+            capture_destroy_mesh(&capture, MeshHandle(handle));
+        }
+    } else {
+        if (pending_destroys.headless) {
+            null_renderer_destroy_texture(&null_renderer, TextureHandle(handle));
+        } else {
+            renderer_destroy_texture(&renderer, TextureHandle(handle));
+        }
+
+        if (capture.file) {
+            capture_destroy_texture(&capture, TextureHandle(handle));
+        }
+    }
+}
+
+// Fails when out of memory, the caller then destroys right away
+static bool pending_destroy_push(PendingDestroyType type, Uint32 handle)
+{
+    SDL_LockMutex(pending_destroys.lock);
+
+    if (pending_destroys.count == pending_destroys.capacity) {
+        size_t capacity = pending_destroys.capacity == 0 ? 64 : pending_destroys.capacity * 2;
+
+        auto* destroys = (PendingDestroy*)SDL_realloc(pending_destroys.destroys, capacity * sizeof(PendingDestroy));
+        if (!destroys) {
+            SDL_UnlockMutex(pending_destroys.lock);
+            log_err("Out of memory, destroying a handle that may still be drawn");
+            return false;
+        }
+
+        pending_destroys.destroys = destroys;
+        pending_destroys.capacity = capacity;
+    }
+
+    pending_destroys.destroys[pending_destroys.count++] = {
+        .type = type,
+        .handle = handle,
+        .list = pending_destroys.lists_begun,
+    };
+
+    SDL_UnlockMutex(pending_destroys.lock);
+    return true;
+}
+
 LOAD_ENTIRE_FILE(load_entire_file_sdl)
 {
     return SDL_LoadFile(file, datasize);
 }
 
+FREE_FILE(free_file_sdl)
+{
+    SDL_free(data);
+}
+
 CREATE_TEXTURE(create_texture_sdl)
 {
     return renderer_create_texture(&renderer, rgba_data, width, height);
 }
 
+CREATE_TEXTURE_FROM_DATA(create_texture_from_data_sdl)
+{
+    return renderer_create_texture_from_data(&renderer, texture_data);
+}
+
+IS_TEXTURE_FORMAT_SUPPORTED(is_texture_format_supported_sdl)
+{
+    return renderer_is_texture_format_supported(&renderer, format);
+}
+
 CREATE_MESH(create_mesh_sdl)
 {
     return renderer_create_mesh(&renderer, mesh_data);
 }
 
+CREATE_MESHES(create_meshes_sdl)
+{
+    renderer_create_meshes(&renderer, mesh_datas, count, out_handles);
+}
+
+DESTROY_MESH(destroy_mesh_sdl)
+{
+    if (!pending_destroy_push(PENDING_DESTROY_MESH, handle.value)) {
+        destroy_now(PENDING_DESTROY_MESH, handle.value);
+    }
+}
+
+DESTROY_TEXTURE(destroy_texture_sdl)
+{
+    if (!pending_destroy_push(PENDING_DESTROY_TEXTURE, handle.value)) {
+        destroy_now(PENDING_DESTROY_TEXTURE, handle.value);
+    }
+}
+
+IS_MESH_READY(is_mesh_ready_sdl)
+{
+    return renderer_is_mesh_ready(&renderer, handle);
+}
+
+IS_TEXTURE_READY(is_texture_ready_sdl)
+{
+    return renderer_is_texture_ready(&renderer, handle);
+}
+
+CREATE_DYNAMIC_MESH(create_dynamic_mesh_sdl)
+{
+    return renderer_create_dynamic_mesh(&renderer, max_vertices, max_indices);
+}
+
+MAP_DYNAMIC_MESH(map_dynamic_mesh_sdl)
+{
+    return renderer_map_dynamic_mesh(&renderer, handle, out_mesh_data);
+}
+
+COMMIT_DYNAMIC_MESH(commit_dynamic_mesh_sdl)
+{
+    renderer_commit_dynamic_mesh(&renderer, handle, vertices_count, indices_count);
+}
+
+CREATE_MATERIAL(create_material_sdl)
+{
+    return renderer_create_material(&renderer, albedo, flags);
+}
+
 static Api api = {
     .load_entire_file = load_entire_file_sdl,
+    .free_file = free_file_sdl,
     .create_texture = create_texture_sdl,
+    .create_texture_from_data = create_texture_from_data_sdl,
+    .is_texture_format_supported = is_texture_format_supported_sdl,
+    .destroy_mesh = destroy_mesh_sdl,
+    .destroy_texture = destroy_texture_sdl,
     .create_mesh = create_mesh_sdl,
+    .create_meshes = create_meshes_sdl,
+    .is_mesh_ready = is_mesh_ready_sdl,
+    .is_texture_ready = is_texture_ready_sdl,
+    .create_dynamic_mesh = create_dynamic_mesh_sdl,
+    .map_dynamic_mesh = map_dynamic_mesh_sdl,
+    .commit_dynamic_mesh = commit_dynamic_mesh_sdl,
+    .create_material = create_material_sdl,
+};
+
+// The null renderer backs the Api with --headless
+CREATE_TEXTURE(create_texture_null)
+{
+    return null_renderer_create_texture(&null_renderer, rgba_data, width, height);
+}
+
+CREATE_TEXTURE_FROM_DATA(create_texture_from_data_null)
+{
+    return null_renderer_create_texture_from_data(&null_renderer, texture_data);
+}
+
+IS_TEXTURE_FORMAT_SUPPORTED(is_texture_format_supported_null)
+{
+    return null_renderer_is_texture_format_supported(&null_renderer, format);
+}
+
+CREATE_MESH(create_mesh_null)
+{
+    return null_renderer_create_mesh(&null_renderer, mesh_data);
+}
+
+CREATE_MESHES(create_meshes_null)
+{
+    null_renderer_create_meshes(&null_renderer, mesh_datas, count, out_handles);
+}
+
+DESTROY_MESH(destroy_mesh_null)
+{
+    if (!pending_destroy_push(PENDING_DESTROY_MESH, handle.value)) {
+        destroy_now(PENDING_DESTROY_MESH, handle.value);
+    }
+}
+
+DESTROY_TEXTURE(destroy_texture_null)
+{
+    if (!pending_destroy_push(PENDING_DESTROY_TEXTURE, handle.value)) {
+        destroy_now(PENDING_DESTROY_TEXTURE, handle.value);
+    }
+}
+
+IS_MESH_READY(is_mesh_ready_null)
+{
+    return null_renderer_is_mesh_ready(&null_renderer, handle);
+}
+
+IS_TEXTURE_READY(is_texture_ready_null)
+{
+    return null_renderer_is_texture_ready(&null_renderer, handle);
+}
+
+CREATE_DYNAMIC_MESH(create_dynamic_mesh_null)
+{
+    return null_renderer_create_dynamic_mesh(&null_renderer, max_vertices, max_indices);
+}
+
+MAP_DYNAMIC_MESH(map_dynamic_mesh_null)
+{
+    return null_renderer_map_dynamic_mesh(&null_renderer, handle, out_mesh_data);
+}
+
+COMMIT_DYNAMIC_MESH(commit_dynamic_mesh_null)
+{
+    null_renderer_commit_dynamic_mesh(&null_renderer, handle, vertices_count, indices_count);
+}
+
+CREATE_MATERIAL(create_material_null)
+{
+    return null_renderer_create_material(&null_renderer, albedo, flags);
+}
+
+static Api null_api = {
+    .load_entire_file = load_entire_file_sdl,
+    .free_file = free_file_sdl,
+    .create_texture = create_texture_null,
+    .create_texture_from_data = create_texture_from_data_null,
+    .is_texture_format_supported = is_texture_format_supported_null,
+    .destroy_mesh = destroy_mesh_null,
+    .destroy_texture = destroy_texture_null,
+    .create_mesh = create_mesh_null,
+    .create_meshes = create_meshes_null,
+    .is_mesh_ready = is_mesh_ready_null,
+    .is_texture_ready = is_texture_ready_null,
+    .create_dynamic_mesh = create_dynamic_mesh_null,
+    .map_dynamic_mesh = map_dynamic_mesh_null,
+    .commit_dynamic_mesh = commit_dynamic_mesh_null,
+    .create_material = create_material_null,
+};
+
+// With --capture the game gets these instead, they forward to the selected
+// backend and record every resource it creates
+Api* backend_api;
+
+CREATE_TEXTURE(create_texture_capture)
+{
+    TextureHandle handle = backend_api->create_texture(rgba_data, width, height);
+
+    if (handle) {
+        TextureData texture_data = {
+            .format = TextureFormat::RGBA8,
+            .width = (uint32_t)width,
+            .height = (uint32_t)height,
+            .mip_count = 0,
+            .data = rgba_data,
+            .size = texture_level_size(TextureFormat::RGBA8, width, height),
+        };
+
+        capture_texture(&capture, handle, &texture_data);
+    }
+
+    return handle;
+}
+
+CREATE_TEXTURE_FROM_DATA(create_texture_from_data_capture)
+{
+    TextureHandle handle = backend_api->create_texture_from_data(texture_data);
+
+    if (handle) {
+        capture_texture(&capture, handle, texture_data);
+    }
+
+    return handle;
+}
+
+IS_TEXTURE_FORMAT_SUPPORTED(is_texture_format_supported_capture)
+{
+    return backend_api->is_texture_format_supported(format);
+}
+
+CREATE_MESH(create_mesh_capture)
+{
+    MeshHandle handle = backend_api->create_mesh(mesh_data);
+
+    if (handle) {
+        capture_mesh(&capture, handle, mesh_data);
+    }
+
+    return handle;
+}
+
+CREATE_MESHES(create_meshes_capture)
+{
+    for (size_t i = 0; i < count; i++) {
+        out_handles[i] = create_mesh_capture(&mesh_datas[i]);
+    }
+}
+
+// Recorded by destroy_now once the destroy is applied
+DESTROY_MESH(destroy_mesh_capture)
+{
+    backend_api->destroy_mesh(handle);
+}
+
+DESTROY_TEXTURE(destroy_texture_capture)
+{
+    backend_api->destroy_texture(handle);
+}
+
+IS_MESH_READY(is_mesh_ready_capture)
+{
+    return backend_api->is_mesh_ready(handle);
+}
+
+IS_TEXTURE_READY(is_texture_ready_capture)
+{
+    return backend_api->is_texture_ready(handle);
+}
+
+CREATE_MATERIAL(create_material_capture)
+{
+    MaterialHandle handle = backend_api->create_material(albedo, flags);
+
+    if (handle) {
+        capture_material(&capture, handle, albedo, flags);
+    }
+
+    return handle;
+}
+
+// Dynamic contents are not recorded, replays skip the draws that use them
+CREATE_DYNAMIC_MESH(create_dynamic_mesh_capture)
+{
+    return backend_api->create_dynamic_mesh(max_vertices, max_indices);
+}
+
+MAP_DYNAMIC_MESH(map_dynamic_mesh_capture)
+{
+    return backend_api->map_dynamic_mesh(handle, out_mesh_data);
+}
+
+COMMIT_DYNAMIC_MESH(commit_dynamic_mesh_capture)
+{
+    backend_api->commit_dynamic_mesh(handle, vertices_count, indices_count);
+}
+
+static Api capture_api = {
+    .load_entire_file = load_entire_file_sdl,
+    .free_file = free_file_sdl,
+    .create_texture = create_texture_capture,
+    .create_texture_from_data = create_texture_from_data_capture,
+    .is_texture_format_supported = is_texture_format_supported_capture,
+    .destroy_mesh = destroy_mesh_capture,
+    .destroy_texture = destroy_texture_capture,
+    .create_mesh = create_mesh_capture,
+    .create_meshes = create_meshes_capture,
+    .is_mesh_ready = is_mesh_ready_capture,
+    .is_texture_ready = is_texture_ready_capture,
+    .create_dynamic_mesh = create_dynamic_mesh_capture,
+    .map_dynamic_mesh = map_dynamic_mesh_capture,
+    .commit_dynamic_mesh = commit_dynamic_mesh_capture,
+    .create_material = create_material_capture,
 };
 
 typedef struct {
@@ -42,7 +421,12 @@ typedef struct {
     SDL_GPUDevice* device;
     SDL_SharedObject* game_so;
     GameIterateFn* game_iterate;
+    // Optional, NULL when the game does not export it
+    LateLatchCameraFn* late_latch_camera;
     const char* game_so_file;
+    // Held by the game thread around game_iterate so the SO is never
+    // swapped under it
+    SDL_Mutex* game_lock;
 } PlatformState;
 
 void reload_game_so(PlatformState* platform_state, const char* path)
@@ -60,6 +444,8 @@ void reload_game_so(PlatformState* platform_state, const char* path)
     if (!platform_state->game_iterate) {
         log_fatal("%s", SDL_GetError());
     }
+
+    platform_state->late_latch_camera = (LateLatchCameraFn*)SDL_LoadFunction(platform_state->game_so, "late_latch_camera");
 }
 
 typedef struct {
@@ -73,28 +459,265 @@ void game_so_watcher_callback(FileWatcherEvent* event, void* user_data)
     auto* data = (GameSoWatcherCallbackData*)user_data;
 
     if (event->type == FW_MODIFY && strcmp(event->file_name, data->game_so_name) == 0) {
+        SDL_LockMutex(data->platform_state->game_lock);
         reload_game_so(data->platform_state, data->game_so_path);
+        SDL_UnlockMutex(data->platform_state->game_lock);
         log_info("Reloaded game SO");
     }
 }
 
-int main(int argc, char* argv[])
+typedef struct {
+    PlatformState* platform_state;
+    GameMemory* memory;
+    Api* api;
+    FrameQueue* frame_queue;
+
+    // Gathered from events by the main thread, consumed once per game frame
+    SDL_Mutex* input_lock;
+    ControllerInput input;
+    // Never reset, late latching diffs it against the value a draw list saw
+    glm::vec2 mouse_total;
+
+    SDL_AtomicInt quit;
+} GameThreadState;
+
+// Main thread, after a draw list was played: hands the destroys issued while
+// it or an earlier list was built to the renderer
+static void apply_pending_destroys()
 {
-    if (argc != 2) {
-        fprintf(stderr, "Usage: almond ./libgame.so\n");
-        exit(1);
+    SDL_LockMutex(pending_destroys.lock);
+
+    pending_destroys.lists_played++;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < pending_destroys.count; i++) {
+        PendingDestroy destroy = pending_destroys.destroys[i];
+
+        if (destroy.list > pending_destroys.lists_played) {
+            pending_destroys.destroys[kept++] = destroy;
+            continue;
+        }
+
+        destroy_now(destroy.type, destroy.handle);
+    }
+
+    pending_destroys.count = kept;
+
+    SDL_UnlockMutex(pending_destroys.lock);
+}
+
+// Builds draw lists into the frame queue while the main thread renders the
+// previous one. SDL needs the window, its events and the swapchain on the
+// main thread, so the game is the side that moves.
+static int game_thread(void* user_data)
+{
+    auto* state = (GameThreadState*)user_data;
+
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    Uint64 last = SDL_GetPerformanceCounter();
+
+    for (;;) {
+        DrawList* draw_list = frame_queue_begin_write(state->frame_queue);
+
+        if (SDL_GetAtomicInt(&state->quit)) {
+            break;
+        }
+
+        SDL_LockMutex(pending_destroys.lock);
+        pending_destroys.lists_begun++;
+        SDL_UnlockMutex(pending_destroys.lock);
+
+        Uint64 now = SDL_GetPerformanceCounter();
+        float dt = (float)((double)(now - last) / (double)frequency);
+        last = now;
+
+        SDL_LockMutex(state->input_lock);
+
+        ControllerInput input = state->input;
+        draw_list->input_ticks = SDL_GetPerformanceCounter();
+        draw_list->input_mouse_total = state->mouse_total;
+
+        // Scoobydoo hack to iterate over all buttons
+        for (size_t i = 0; i < sizeof(state->input.buttons) / sizeof(GameButtonState); i++) {
+            state->input.buttons[i].half_transition_count = 0;
+        }
+
+        state->input.mouse_movement = glm::vec2(0.0f);
+
+        SDL_UnlockMutex(state->input_lock);
+
+        SDL_LockMutex(state->platform_state->game_lock);
+        state->platform_state->game_iterate(state->memory, &input, draw_list, dt, state->api);
+        SDL_UnlockMutex(state->platform_state->game_lock);
+
+        frame_queue_end_write(state->frame_queue);
+    }
+
+    return 0;
+}
+
+static void add_mouse_motion(GameThreadState* state, const SDL_MouseMotionEvent* motion)
+{
+    state->input.mouse_movement.x += motion->xrel;
+    state->input.mouse_movement.y += motion->yrel;
+    state->mouse_total.x += motion->xrel;
+    state->mouse_total.y += motion->yrel;
+}
+
+// Runs on the main thread once the renderer holds a swapchain texture. Mouse
+// motion queued since the last event poll is consumed here so the camera of
+// the list being rendered sees it a frame early; the same motion still
+// reaches the game through the input it samples next. Reloads also happen on
+// the main thread, so late_latch_camera cannot be unloaded under this call.
+static bool late_latch_camera(const DrawList* draw_list, Camera* out_camera, void* user_data)
+{
+    auto* state = (GameThreadState*)user_data;
+
+    if (!state->platform_state->late_latch_camera) {
+        return false;
+    }
+
+    SDL_PumpEvents();
+
+    SDL_LockMutex(state->input_lock);
+
+    SDL_Event event;
+    while (SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_EVENT_MOUSE_MOTION, SDL_EVENT_MOUSE_MOTION) > 0) {
+        add_mouse_motion(state, &event.motion);
     }
 
-    if (!SDL_Init(SDL_INIT_VIDEO)) {
+    glm::vec2 mouse_delta = state->mouse_total - draw_list->input_mouse_total;
+
+    SDL_UnlockMutex(state->input_lock);
+
+    *out_camera = state->platform_state->late_latch_camera(draw_list->late_latch_data, mouse_delta);
+
+    return true;
+}
+
+typedef struct {
+    const char* game_so_path;
+    RendererConfig renderer_config;
+    float fps_cap;
+    // Run without a window or GPU through the null renderer
+    bool headless;
+    // Exit after this many frames, 0 runs until quit
+    Uint64 frame_count;
+    // Trace file recording resources and draw lists, for almond_replay
+    const char* capture_path;
+} Options;
+
+static void print_usage_and_exit()
+{
+    fprintf(stderr, "Usage: almond [--present-mode vsync|mailbox|immediate] [--frames-in-flight N] [--fps-cap N] [--msaa 1|2|4|8] [--frame-budget MS] [--stats] [--depth-prepass] [--gpu-culling] [--headless] [--frames N] [--capture FILE] ./libgame.so\n");
+    exit(1);
+}
+
+static Options parse_options(int argc, char* argv[])
+{
+    Options options = {};
+    options.renderer_config.present_mode = SDL_GPU_PRESENTMODE_VSYNC;
+    options.renderer_config.frames_in_flight = 2;
+    options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_4;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(arg, "--present-mode") == 0 && has_value) {
+            const char* mode = argv[++i];
+
+            if (strcmp(mode, "vsync") == 0) {
+                options.renderer_config.present_mode = SDL_GPU_PRESENTMODE_VSYNC;
+            } else if (strcmp(mode, "mailbox") == 0) {
+                options.renderer_config.present_mode = SDL_GPU_PRESENTMODE_MAILBOX;
+            } else if (strcmp(mode, "immediate") == 0) {
+                options.renderer_config.present_mode = SDL_GPU_PRESENTMODE_IMMEDIATE;
+            } else {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(arg, "--frames-in-flight") == 0 && has_value) {
+            options.renderer_config.frames_in_flight = (Uint32)atoi(argv[++i]);
+        } else if (strcmp(arg, "--fps-cap") == 0 && has_value) {
+            options.fps_cap = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "--msaa") == 0 && has_value) {
+            int samples = atoi(argv[++i]);
+
+            if (samples == 1) {
+                options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_1;
+            } else if (samples == 2) {
+                options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_2;
+            } else if (samples == 4) {
+                options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_4;
+            } else if (samples == 8) {
+                options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_8;
+            } else {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(arg, "--frame-budget") == 0 && has_value) {
+            options.renderer_config.frame_budget_ms = (float)atof(argv[++i]);
+        } else if (strcmp(arg, "--stats") == 0) {
+            options.renderer_config.log_stats = true;
+        } else if (strcmp(arg, "--depth-prepass") == 0) {
+            options.renderer_config.depth_prepass = true;
+        } else if (strcmp(arg, "--gpu-culling") == 0) {
+            options.renderer_config.gpu_culling = true;
+        } else if (strcmp(arg, "--headless") == 0) {
+            options.headless = true;
+        } else if (strcmp(arg, "--frames") == 0 && has_value) {
+            options.frame_count = (Uint64)atoll(argv[++i]);
+        } else if (strcmp(arg, "--capture") == 0 && has_value) {
+            options.capture_path = argv[++i];
+        } else if (arg[0] != '-' && !options.game_so_path) {
+            options.game_so_path = arg;
+        } else {
+            print_usage_and_exit();
+        }
+    }
+
+    if (!options.game_so_path) {
+        print_usage_and_exit();
+    }
+
+    return options;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options = parse_options(argc, argv);
+
+    if (!SDL_Init(options.headless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO)) {
         log_fatal("%s", SDL_GetError());
     }
 
     PlatformState platform = {};
+    Api* game_api = &api;
+
+    if (options.headless) {
+        if (!null_renderer_init(&null_renderer)) {
+            log_fatal("Could not initialize the null renderer");
+        }
 
-    platform.window = SDL_CreateWindow("Game", 1280, 720, 0);
+        game_api = &null_api;
+    } else {
+        platform.window = SDL_CreateWindow("Game", 1280, 720, 0);
 
-    if (!platform.window) {
-        log_fatal("%s", SDL_GetError());
+        if (!platform.window) {
+            log_fatal("%s", SDL_GetError());
+        }
+
+        if (!renderer_init(&renderer, platform.window, &options.renderer_config)) {
+            log_fatal("Could not initialize the renderer");
+        }
+    }
+
+    if (options.capture_path) {
+        if (!capture_open(&capture, options.capture_path)) {
+            log_fatal("Could not start capture");
+        }
+
+        backend_api = game_api;
+        game_api = &capture_api;
     }
 
     GameMemory memory = {};
@@ -107,24 +730,35 @@ int main(int argc, char* argv[])
     memory.transient_storage = mmap(NULL, memory.transient_storage_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     ;
 
-    renderer_init(&renderer, platform.window);
+    FrameQueue frame_queue;
+    if (!frame_queue_init(&frame_queue)) {
+        log_fatal("Could not create the frame queue");
+    }
+
+    platform.game_lock = SDL_CreateMutex();
+    if (!platform.game_lock) {
+        log_fatal("%s", SDL_GetError());
+    }
 
-    DrawList draw_list = {};
-    draw_list.capacity = Megabytes(10);
-    draw_list.commands = (DrawCommand*)SDL_malloc(draw_list.capacity);
+    pending_destroys.lock = SDL_CreateMutex();
+    if (!pending_destroys.lock) {
+        log_fatal("%s", SDL_GetError());
+    }
 
-    reload_game_so(&platform, argv[1]);
+    pending_destroys.headless = options.headless;
 
-    char* dir_path = SDL_strdup(argv[1]);
+    reload_game_so(&platform, options.game_so_path);
+
+    char* dir_path = SDL_strdup(options.game_so_path);
     dir_path = dirname(dir_path);
 
-    char* file_name = SDL_strdup(argv[1]);
+    char* file_name = SDL_strdup(options.game_so_path);
     file_name = basename(file_name);
 
     GameSoWatcherCallbackData callback_data = {};
     callback_data.platform_state = &platform;
     callback_data.game_so_name = file_name;
-    callback_data.game_so_path = argv[1];
+    callback_data.game_so_path = options.game_so_path;
 
     FileWatcher* file_watcher = create_file_watcher(dir_path, game_so_watcher_callback, &callback_data);
     if (!file_watcher) {
@@ -133,21 +767,38 @@ int main(int argc, char* argv[])
 
     SDL_free(dir_path);
 
-    Uint64 last_ticks = SDL_GetTicks();
+    FramePacer pacer;
+    frame_pacer_init(&pacer, options.fps_cap);
+
+    GameThreadState game_state = {};
+    game_state.platform_state = &platform;
+    game_state.memory = &memory;
+    game_state.api = game_api;
+    game_state.frame_queue = &frame_queue;
+    game_state.input_lock = SDL_CreateMutex();
+
+    if (!game_state.input_lock) {
+        log_fatal("%s", SDL_GetError());
+    }
+
+    if (!options.headless) {
+        renderer.late_latch = late_latch_camera;
+        renderer.late_latch_user_data = &game_state;
+    }
+
+    SDL_Thread* game_thread_handle = SDL_CreateThread(game_thread, "game", &game_state);
+    if (!game_thread_handle) {
+        log_fatal("%s", SDL_GetError());
+    }
 
     bool running = true;
-    ControllerInput input = {};
+    ControllerInput& input = game_state.input;
+    Uint64 frames = 0;
 
     while (running) {
-        Uint64 current_ticks = SDL_GetTicks();
-        float dt = (float)(current_ticks - last_ticks) / 1000.0f;
-
-        // Scoobydoo hack to iterate over all buttons
-        for (size_t i = 0; i < sizeof(input.buttons) / sizeof(GameButtonState); i++) {
-            input.buttons[i].half_transition_count = 0;
-        }
+        frame_pacer_begin_frame(&pacer);
 
-        input.mouse_movement = glm::vec2(0.0f);
+        SDL_LockMutex(game_state.input_lock);
 
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
@@ -159,8 +810,7 @@ int main(int argc, char* argv[])
                 SDL_SetWindowRelativeMouseMode(platform.window, true);
             } break;
             case SDL_EVENT_MOUSE_MOTION: {
-                input.mouse_movement.x += event.motion.xrel;
-                input.mouse_movement.y += event.motion.yrel;
+                add_mouse_motion(&game_state, &event.motion);
             } break;
             case SDL_EVENT_KEY_DOWN: {
                 if (event.key.repeat) continue;
@@ -169,6 +819,24 @@ int main(int argc, char* argv[])
                 case SDLK_ESCAPE: {
                     SDL_SetWindowRelativeMouseMode(platform.window, false);
                 } break;
+                case SDLK_F1: {
+                    // Cycles 1x, 2x, 4x, 8x MSAA
+                    auto sample_count = (SDL_GPUSampleCount)((renderer.sample_count + 1) % (SDL_GPU_SAMPLECOUNT_8 + 1));
+                    renderer_set_sample_count(&renderer, sample_count);
+                    log_info("MSAA %ux", 1u << sample_count);
+                } break;
+                case SDLK_F2: {
+                    renderer.depth_prepass = !renderer.depth_prepass;
+                    log_info("Depth pre-pass %s", renderer.depth_prepass ? "on" : "off");
+                } break;
+                case SDLK_F3: {
+                    renderer.overdraw_view = !renderer.overdraw_view;
+                    log_info("Overdraw view %s", renderer.overdraw_view ? "on" : "off");
+                } break;
+                case SDLK_F4: {
+                    renderer.gpu_culling = !renderer.gpu_culling;
+                    log_info("GPU culling %s", renderer.gpu_culling ? "on" : "off");
+                } break;
                 case SDLK_W: {
                     input.move_up.half_transition_count++;
                     input.move_up.pressed = true;
@@ -189,6 +857,10 @@ int main(int argc, char* argv[])
                     input.move_jump.half_transition_count++;
                     input.move_jump.pressed = true;
                 } break;
+                case SDLK_F5: {
+                    input.toggle_debug_draw.half_transition_count++;
+                    input.toggle_debug_draw.pressed = true;
+                } break;
                 default:
                     break;
                 }
@@ -217,6 +889,10 @@ int main(int argc, char* argv[])
                     input.move_jump.half_transition_count++;
                     input.move_jump.pressed = false;
                 } break;
+                case SDLK_F5: {
+                    input.toggle_debug_draw.half_transition_count++;
+                    input.toggle_debug_draw.pressed = false;
+                } break;
                 default:
                     break;
                 }
@@ -226,15 +902,50 @@ int main(int argc, char* argv[])
             }
         }
 
+        SDL_UnlockMutex(game_state.input_lock);
+
         file_watcher_update(file_watcher);
 
-        draw_list.count = 0;
+        // Events keep being pumped while the game is busy, e.g. loading
+        DrawList* draw_list = frame_queue_begin_read(&frame_queue, 100);
+        if (!draw_list) {
+            continue;
+        }
+
+        if (options.capture_path) {
+            capture_frame(&capture, draw_list);
+        }
+
+        if (options.headless) {
+            null_renderer_play_draw_list(&null_renderer, draw_list);
+            frame_pacer_end_frame(&pacer, 0);
+        } else {
+            renderer_play_draw_list(&renderer, draw_list);
+            frame_pacer_end_frame(&pacer, renderer.swapchain_wait_ticks);
+            // The pacer's cpu time includes waiting on the game thread, which a
+            // lower resolution would not shorten
+            RenderStats* stats = &draw_list->stats;
+            resolution_scaler_update(&renderer.resolution_scaler, stats->record_ms + stats->submit_ms + stats->swapchain_wait_ms);
+        }
+
+        apply_pending_destroys();
+        frame_queue_end_read(&frame_queue);
+
+        if (options.frame_count != 0 && ++frames == options.frame_count) {
+            running = false;
+        }
+    }
 
-        platform.game_iterate(&memory, &input, &draw_list, dt, &api);
+    SDL_SetAtomicInt(&game_state.quit, 1);
+    frame_queue_release_writer(&frame_queue);
+    SDL_WaitThread(game_thread_handle, NULL);
 
-        renderer_play_draw_list(&renderer, &draw_list);
+    capture_close(&capture);
 
-        last_ticks = current_ticks;
+    if (options.headless) {
+        null_renderer_report(&null_renderer);
+    } else {
+        renderer_shutdown(&renderer);
     }
 
     SDL_DestroyWindow(platform.window);
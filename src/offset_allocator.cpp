@@ -0,0 +1,136 @@
+#include "offset_allocator.h"
+
+#include "logger.h"
+
+#define OFFSET_ALLOCATOR_INITIAL_RANGES 64
+
+bool offset_allocator_init(OffsetAllocator* allocator, Uint32 size)
+{
+    allocator->capacity = OFFSET_ALLOCATOR_INITIAL_RANGES;
+    allocator->ranges = (FreeRange*)SDL_malloc(allocator->capacity * sizeof(FreeRange));
+
+    if (!allocator->ranges) {
+        return false;
+    }
+
+    offset_allocator_reset(allocator, size);
+
+    return true;
+}
+
+void offset_allocator_reset(OffsetAllocator* allocator, Uint32 size)
+{
+    allocator->size = size;
+    allocator->free_size = size;
+    allocator->count = 1;
+    allocator->ranges[0] = { .offset = 0, .size = size };
+}
+
+bool offset_allocator_alloc(OffsetAllocator* allocator, Uint32 size, Uint32* out_offset)
+{
+    if (size == 0 || size > allocator->free_size) {
+        return false;
+    }
+
+    for (Uint32 i = 0; i < allocator->count; i++) {
+        FreeRange* range = &allocator->ranges[i];
+
+        if (range->size < size) {
+            continue;
+        }
+
+        *out_offset = range->offset;
+
+        range->offset += size;
+        range->size -= size;
+
+        if (range->size == 0) {
+            allocator->count--;
+            SDL_memmove(range, range + 1, (allocator->count - i) * sizeof(FreeRange));
+        }
+
+        allocator->free_size -= size;
+
+        return true;
+    }
+
+    return false;
+}
+
+void offset_allocator_free(OffsetAllocator* allocator, Uint32 offset, Uint32 size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    // Find the first range after the freed one
+    Uint32 low = 0;
+    Uint32 high = allocator->count;
+
+    while (low < high) {
+        Uint32 mid = (low + high) / 2;
+
+        if (allocator->ranges[mid].offset < offset) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    Uint32 index = low;
+
+    allocator->free_size += size;
+
+    bool merges_prev = index > 0 && allocator->ranges[index - 1].offset + allocator->ranges[index - 1].size == offset;
+    bool merges_next = index < allocator->count && offset + size == allocator->ranges[index].offset;
+
+    if (merges_prev && merges_next) {
+        allocator->ranges[index - 1].size += size + allocator->ranges[index].size;
+        allocator->count--;
+        SDL_memmove(&allocator->ranges[index], &allocator->ranges[index + 1], (allocator->count - index) * sizeof(FreeRange));
+        return;
+    }
+
+    if (merges_prev) {
+        allocator->ranges[index - 1].size += size;
+        return;
+    }
+
+    if (merges_next) {
+        allocator->ranges[index].offset = offset;
+        allocator->ranges[index].size += size;
+        return;
+    }
+
+    if (allocator->count == allocator->capacity) {
+        Uint32 new_capacity = allocator->capacity * 2;
+        FreeRange* new_ranges = (FreeRange*)SDL_realloc(allocator->ranges, new_capacity * sizeof(FreeRange));
+
+        if (!new_ranges) {
+            // The range is leaked until the next reset
+            log_err("Offset allocator out of memory");
+            allocator->free_size -= size;
+            return;
+        }
+
+        allocator->ranges = new_ranges;
+        allocator->capacity = new_capacity;
+    }
+
+    SDL_memmove(&allocator->ranges[index + 1], &allocator->ranges[index], (allocator->count - index) * sizeof(FreeRange));
+    allocator->ranges[index] = { .offset = offset, .size = size };
+    allocator->count++;
+}
+
+Uint32 offset_allocator_largest_free_range(OffsetAllocator* allocator)
+{
+    Uint32 largest = 0;
+
+    for (Uint32 i = 0; i < allocator->count; i++) {
+        if (allocator->ranges[i].size > largest) {
+            largest = allocator->ranges[i].size;
+        }
+    }
+
+    return largest;
+}
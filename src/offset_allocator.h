@@ -0,0 +1,26 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+typedef struct {
+    Uint32 offset;
+    Uint32 size;
+} FreeRange;
+
+// Sub-allocates ranges out of a linear address space (e.g. a GPU buffer).
+// Free ranges are kept sorted by offset and merged with their neighbours on
+// free, allocation takes the first range large enough.
+typedef struct {
+    FreeRange* ranges;
+    Uint32 count;
+    Uint32 capacity;
+
+    Uint32 size;
+    Uint32 free_size;
+} OffsetAllocator;
+
+bool offset_allocator_init(OffsetAllocator* allocator, Uint32 size);
+void offset_allocator_reset(OffsetAllocator* allocator, Uint32 size);
+bool offset_allocator_alloc(OffsetAllocator* allocator, Uint32 size, Uint32* out_offset);
+void offset_allocator_free(OffsetAllocator* allocator, Uint32 offset, Uint32 size);
+Uint32 offset_allocator_largest_free_range(OffsetAllocator* allocator);
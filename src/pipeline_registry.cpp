@@ -0,0 +1,392 @@
+#include "pipeline_registry.h"
+
+#include "logger.h"
+#include "public/almond.h"
+
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_timer.h>
+
+// Shader compilers write their output in several chunks, the events of one
+// write are coalesced before rebuilding
+#define PIPELINE_REBUILD_DELAY_MS 50
+
+static SDL_GPUShader* load_shader(PipelineRegistry* registry, const char* name, SDL_GPUShaderStage stage,
+    Uint32 num_uniform_buffers, Uint32 num_samplers, Uint32 num_storage_buffers)
+{
+    char path[512];
+    SDL_snprintf(path, sizeof(path), "%s/%s", registry->directory, name);
+
+    size_t shader_code_size;
+    void* shader_code = SDL_LoadFile(path, &shader_code_size);
+
+    if (!shader_code) {
+        log_err("%s", SDL_GetError());
+        return NULL;
+    }
+
+    SDL_GPUShaderCreateInfo create_info = {};
+    create_info.code = (Uint8*)shader_code;
+    create_info.code_size = shader_code_size;
+    create_info.entrypoint = "main";
+    create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+    create_info.stage = stage;
+    create_info.num_samplers = num_samplers;
+    create_info.num_storage_buffers = num_storage_buffers;
+    create_info.num_storage_textures = 0;
+    create_info.num_uniform_buffers = num_uniform_buffers;
+
+    SDL_GPUShader* shader = SDL_CreateGPUShader(registry->device, &create_info);
+    if (!shader) {
+        log_err("Could not create shader %s: %s", path, SDL_GetError());
+    }
+
+    SDL_free(shader_code);
+
+    return shader;
+}
+
+static SDL_GPUGraphicsPipeline* build_pipeline(PipelineRegistry* registry, const PipelineDesc* desc)
+{
+    SDL_GPUShader* vertex_shader = load_shader(registry, desc->vertex_shader, SDL_GPU_SHADERSTAGE_VERTEX,
+        desc->vertex_uniform_buffers, 0, desc->vertex_storage_buffers);
+    SDL_GPUShader* fragment_shader = load_shader(registry, desc->fragment_shader, SDL_GPU_SHADERSTAGE_FRAGMENT,
+        0, desc->fragment_samplers, 0);
+
+    if (!vertex_shader || !fragment_shader) {
+        SDL_ReleaseGPUShader(registry->device, vertex_shader);
+        SDL_ReleaseGPUShader(registry->device, fragment_shader);
+        return NULL;
+    }
+
+    SDL_GPUGraphicsPipelineCreateInfo pipeline_create_info = {};
+    pipeline_create_info.vertex_shader = vertex_shader;
+    pipeline_create_info.fragment_shader = fragment_shader;
+    pipeline_create_info.primitive_type = desc->primitive_type;
+    pipeline_create_info.rasterizer_state.fill_mode = desc->fill_mode;
+
+    SDL_GPUVertexBufferDescription vertex_buffer_description[1] = {};
+    vertex_buffer_description[0].slot = 0;
+    vertex_buffer_description[0].input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
+    vertex_buffer_description[0].instance_step_rate = 0;
+    vertex_buffer_description[0].pitch = sizeof(Vertex);
+
+    pipeline_create_info.vertex_input_state.num_vertex_buffers = 1;
+    pipeline_create_info.vertex_input_state.vertex_buffer_descriptions = vertex_buffer_description;
+
+    SDL_GPUVertexAttribute vertex_attributes[2] = {};
+    vertex_attributes[0].buffer_slot = 0;
+    vertex_attributes[0].location = 0;
+    vertex_attributes[0].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
+    vertex_attributes[0].offset = offsetof(Vertex, position);
+
+    // UV attribute
+    vertex_attributes[1].buffer_slot = 0;
+    vertex_attributes[1].location = 1;
+    vertex_attributes[1].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2;
+    vertex_attributes[1].offset = offsetof(Vertex, texcoords);
+
+    pipeline_create_info.vertex_input_state.num_vertex_attributes = 2;
+    pipeline_create_info.vertex_input_state.vertex_attributes = vertex_attributes;
+
+    if (desc->vertex_layout == PIPELINE_VERTEX_LAYOUT_POSITION) {
+        vertex_buffer_description[0].pitch = sizeof(glm::vec3);
+        vertex_attributes[0].offset = 0;
+        pipeline_create_info.vertex_input_state.num_vertex_attributes = 1;
+    } else if (desc->vertex_layout == PIPELINE_VERTEX_LAYOUT_DEBUG) {
+        vertex_buffer_description[0].pitch = sizeof(DebugVertex);
+        vertex_attributes[0].offset = offsetof(DebugVertex, position);
+        vertex_attributes[1].format = SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4_NORM;
+        vertex_attributes[1].offset = offsetof(DebugVertex, color);
+    }
+
+    SDL_GPUColorTargetDescription color_target_descriptions[1] = {};
+    color_target_descriptions[0].format = desc->color_format;
+
+    if (desc->color_mode == PIPELINE_COLOR_NONE) {
+        color_target_descriptions[0].blend_state.enable_color_write_mask = true;
+        color_target_descriptions[0].blend_state.color_write_mask = 0;
+    } else if (desc->color_mode == PIPELINE_COLOR_ADDITIVE) {
+        color_target_descriptions[0].blend_state = {
+            .src_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+            .dst_color_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+            .color_blend_op = SDL_GPU_BLENDOP_ADD,
+            .src_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+            .dst_alpha_blendfactor = SDL_GPU_BLENDFACTOR_ONE,
+            .alpha_blend_op = SDL_GPU_BLENDOP_ADD,
+            .enable_blend = true,
+        };
+    }
+
+    pipeline_create_info.target_info.num_color_targets = 1;
+    pipeline_create_info.target_info.color_target_descriptions = color_target_descriptions;
+    pipeline_create_info.target_info.depth_stencil_format = SDL_GPU_TEXTUREFORMAT_D32_FLOAT;
+    pipeline_create_info.target_info.has_depth_stencil_target = true;
+
+    pipeline_create_info.multisample_state.sample_count = desc->sample_count;
+
+    SDL_GPUDepthStencilState depth_stencil_state = {
+        .compare_op = desc->depth_compare_op,
+        .back_stencil_state = {
+            .compare_op = SDL_GPU_COMPAREOP_ALWAYS },
+        .front_stencil_state = { .compare_op = SDL_GPU_COMPAREOP_ALWAYS },
+        .compare_mask = 0,
+        .write_mask = 0,
+        .enable_depth_test = true,
+        .enable_depth_write = desc->depth_write,
+        .enable_stencil_test = false
+    };
+
+    pipeline_create_info.depth_stencil_state = depth_stencil_state;
+
+    SDL_GPUGraphicsPipeline* pipeline = SDL_CreateGPUGraphicsPipeline(registry->device, &pipeline_create_info);
+
+    if (!pipeline) {
+        log_err("Could not create graphics pipeline: %s", SDL_GetError());
+    }
+
+    SDL_ReleaseGPUShader(registry->device, vertex_shader);
+    SDL_ReleaseGPUShader(registry->device, fragment_shader);
+
+    return pipeline;
+}
+
+static bool pipeline_desc_equal(const PipelineDesc* a, const PipelineDesc* b)
+{
+    return SDL_strcmp(a->vertex_shader, b->vertex_shader) == 0
+        && SDL_strcmp(a->fragment_shader, b->fragment_shader) == 0
+        && a->vertex_uniform_buffers == b->vertex_uniform_buffers
+        && a->vertex_storage_buffers == b->vertex_storage_buffers
+        && a->fragment_samplers == b->fragment_samplers
+        && a->vertex_layout == b->vertex_layout
+        && a->primitive_type == b->primitive_type
+        && a->fill_mode == b->fill_mode
+        && a->depth_compare_op == b->depth_compare_op
+        && a->depth_write == b->depth_write
+        && a->color_mode == b->color_mode
+        && a->color_format == b->color_format
+        && a->sample_count == b->sample_count;
+}
+
+static int rebuild_worker(void* user_data)
+{
+    auto* registry = (PipelineRegistry*)user_data;
+
+    for (;;) {
+        SDL_WaitSemaphore(registry->rebuild_requested);
+
+        if (SDL_GetAtomicInt(&registry->quit)) {
+            break;
+        }
+
+        SDL_Delay(PIPELINE_REBUILD_DELAY_MS);
+
+        while (SDL_TryWaitSemaphore(registry->rebuild_requested)) {
+        }
+
+        int count = SDL_GetAtomicInt(&registry->count);
+
+        for (int i = 0; i < count; i++) {
+            PipelineEntry* entry = &registry->entries[i];
+
+            if (!SDL_CompareAndSwapAtomicInt(&entry->dirty, 1, 0)) {
+                continue;
+            }
+
+            SDL_GPUGraphicsPipeline* pipeline = build_pipeline(registry, &entry->desc);
+            if (!pipeline) {
+                log_warn("Keeping the previous %s/%s pipeline", entry->desc.vertex_shader, entry->desc.fragment_shader);
+                continue;
+            }
+
+            // A rebuild the render thread has not picked up yet is superseded
+            auto* previous = (SDL_GPUGraphicsPipeline*)SDL_SetAtomicPointer(&entry->pending, pipeline);
+            if (previous) {
+                SDL_ReleaseGPUGraphicsPipeline(registry->device, previous);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void shader_watcher_callback(FileWatcherEvent* event, void* user_data)
+{
+    auto* registry = (PipelineRegistry*)user_data;
+
+    if (event->type == FW_DELETE) {
+        return;
+    }
+
+    bool requested = false;
+    int count = SDL_GetAtomicInt(&registry->count);
+
+    for (int i = 0; i < count; i++) {
+        PipelineEntry* entry = &registry->entries[i];
+
+        if (SDL_strcmp(event->file_name, entry->desc.vertex_shader) == 0
+            || SDL_strcmp(event->file_name, entry->desc.fragment_shader) == 0) {
+            SDL_SetAtomicInt(&entry->dirty, 1);
+            requested = true;
+        }
+    }
+
+    if (requested) {
+        SDL_SignalSemaphore(registry->rebuild_requested);
+    }
+}
+
+bool pipeline_registry_init(PipelineRegistry* registry, SDL_GPUDevice* device, const char* directory)
+{
+    SDL_zerop(registry);
+    registry->device = device;
+    registry->directory = directory;
+
+    registry->watcher = create_file_watcher(directory, shader_watcher_callback, registry);
+    if (!registry->watcher) {
+        log_warn("Could not watch %s, shader hot reload is disabled", directory);
+        return true;
+    }
+
+    registry->rebuild_requested = SDL_CreateSemaphore(0);
+    if (!registry->rebuild_requested) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    registry->worker = SDL_CreateThread(rebuild_worker, "pipeline rebuild", registry);
+    if (!registry->worker) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+void pipeline_registry_shutdown(PipelineRegistry* registry)
+{
+    if (registry->worker) {
+        SDL_SetAtomicInt(&registry->quit, 1);
+        SDL_SignalSemaphore(registry->rebuild_requested);
+        SDL_WaitThread(registry->worker, NULL);
+        registry->worker = NULL;
+    }
+
+    SDL_DestroySemaphore(registry->rebuild_requested);
+    registry->rebuild_requested = NULL;
+
+    int count = SDL_GetAtomicInt(&registry->count);
+
+    for (int i = 0; i < count; i++) {
+        PipelineEntry* entry = &registry->entries[i];
+
+        auto* pending = (SDL_GPUGraphicsPipeline*)SDL_SetAtomicPointer(&entry->pending, NULL);
+        if (pending) {
+            SDL_ReleaseGPUGraphicsPipeline(registry->device, pending);
+        }
+
+        SDL_ReleaseGPUGraphicsPipeline(registry->device, entry->pipeline);
+        entry->pipeline = NULL;
+    }
+
+    SDL_SetAtomicInt(&registry->count, 0);
+}
+
+PipelineId pipeline_registry_find_or_create(PipelineRegistry* registry, const PipelineDesc* desc)
+{
+    int count = SDL_GetAtomicInt(&registry->count);
+
+    for (int i = 0; i < count; i++) {
+        if (pipeline_desc_equal(&registry->entries[i].desc, desc)) {
+            return (PipelineId)i + 1;
+        }
+    }
+
+    if (count == PIPELINE_REGISTRY_MAX_PIPELINES) {
+        log_err("Pipeline registry full");
+        return 0;
+    }
+
+    SDL_GPUGraphicsPipeline* pipeline = build_pipeline(registry, desc);
+    if (!pipeline) {
+        return 0;
+    }
+
+    PipelineEntry* entry = &registry->entries[count];
+    entry->desc = *desc;
+    entry->pipeline = pipeline;
+    SDL_SetAtomicPointer(&entry->pending, NULL);
+    SDL_SetAtomicInt(&entry->dirty, 0);
+
+    // Publishes the entry to the watcher and the worker
+    SDL_SetAtomicInt(&registry->count, count + 1);
+
+    return (PipelineId)count + 1;
+}
+
+void pipeline_registry_update(PipelineRegistry* registry)
+{
+    if (registry->watcher) {
+        file_watcher_update(registry->watcher);
+    }
+
+    int count = SDL_GetAtomicInt(&registry->count);
+
+    for (int i = 0; i < count; i++) {
+        PipelineEntry* entry = &registry->entries[i];
+
+        auto* pipeline = (SDL_GPUGraphicsPipeline*)SDL_SetAtomicPointer(&entry->pending, NULL);
+        if (!pipeline) {
+            continue;
+        }
+
+        // Frames in flight keep the old pipeline alive until they complete
+        SDL_ReleaseGPUGraphicsPipeline(registry->device, entry->pipeline);
+        entry->pipeline = pipeline;
+
+        log_info("Reloaded %s/%s pipeline", entry->desc.vertex_shader, entry->desc.fragment_shader);
+    }
+}
+
+SDL_GPUGraphicsPipeline* pipeline_registry_get(PipelineRegistry* registry, PipelineId id)
+{
+    if (id == 0) {
+        return NULL;
+    }
+
+    return registry->entries[id - 1].pipeline;
+}
+
+SDL_GPUComputePipeline* pipeline_registry_create_compute(PipelineRegistry* registry, const ComputePipelineDesc* desc)
+{
+    char path[512];
+    SDL_snprintf(path, sizeof(path), "%s/%s", registry->directory, desc->shader);
+
+    size_t shader_code_size;
+    void* shader_code = SDL_LoadFile(path, &shader_code_size);
+
+    if (!shader_code) {
+        log_err("%s", SDL_GetError());
+        return NULL;
+    }
+
+    SDL_GPUComputePipelineCreateInfo create_info = {};
+    create_info.code = (Uint8*)shader_code;
+    create_info.code_size = shader_code_size;
+    create_info.entrypoint = "main";
+    create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
+    create_info.num_readonly_storage_buffers = desc->readonly_storage_buffers;
+    create_info.num_readwrite_storage_buffers = desc->readwrite_storage_buffers;
+    create_info.num_uniform_buffers = desc->uniform_buffers;
+    create_info.threadcount_x = desc->threadcount_x;
+    create_info.threadcount_y = 1;
+    create_info.threadcount_z = 1;
+
+    SDL_GPUComputePipeline* pipeline = SDL_CreateGPUComputePipeline(registry->device, &create_info);
+    if (!pipeline) {
+        log_err("Could not create compute pipeline %s: %s", path, SDL_GetError());
+    }
+
+    SDL_free(shader_code);
+
+    return pipeline;
+}
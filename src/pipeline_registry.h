@@ -0,0 +1,107 @@
+#pragma once
+
+#include "file_watcher.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+
+#define PIPELINE_REGISTRY_MAX_PIPELINES 32
+
+typedef enum {
+    // Interleaved Vertex, position at location 0 and UV at location 1
+    PIPELINE_VERTEX_LAYOUT_VERTEX,
+    // Tightly packed positions at location 0, the mesh pool position stream
+    PIPELINE_VERTEX_LAYOUT_POSITION,
+    // DebugVertex, position at location 0 and color at location 1
+    PIPELINE_VERTEX_LAYOUT_DEBUG,
+} PipelineVertexLayout;
+
+typedef enum {
+    PIPELINE_COLOR_WRITE,
+    // Depth only, the color target is left untouched
+    PIPELINE_COLOR_NONE,
+    // Output is added to the color target
+    PIPELINE_COLOR_ADDITIVE,
+} PipelineColorMode;
+
+// Everything a pipeline is built from. Shaders are SPIR-V file names inside
+// the registry directory.
+typedef struct {
+    const char* vertex_shader;
+    const char* fragment_shader;
+    Uint32 vertex_uniform_buffers;
+    Uint32 vertex_storage_buffers;
+    Uint32 fragment_samplers;
+
+    PipelineVertexLayout vertex_layout;
+    SDL_GPUPrimitiveType primitive_type;
+    SDL_GPUFillMode fill_mode;
+    SDL_GPUCompareOp depth_compare_op;
+    bool depth_write;
+
+    PipelineColorMode color_mode;
+    SDL_GPUTextureFormat color_format;
+    SDL_GPUSampleCount sample_count;
+} PipelineDesc;
+
+// Index of a pipeline plus one, 0 is invalid
+typedef Uint32 PipelineId;
+
+typedef struct {
+    PipelineDesc desc;
+
+    // The pipeline draws use, only touched by the render thread
+    SDL_GPUGraphicsPipeline* pipeline;
+
+    // Rebuilt pipeline waiting for the next frame boundary
+    void* pending;
+    SDL_AtomicInt dirty;
+} PipelineEntry;
+
+// Builds pipelines once per distinct description and rebuilds them when their
+// shaders change on disk. Rebuilds run on a worker thread; the previous
+// pipeline stays in use until the render thread swaps the new one in.
+typedef struct {
+    SDL_GPUDevice* device;
+    const char* directory;
+    FileWatcher* watcher;
+
+    PipelineEntry entries[PIPELINE_REGISTRY_MAX_PIPELINES];
+    SDL_AtomicInt count;
+
+    SDL_Thread* worker;
+    SDL_Semaphore* rebuild_requested;
+    SDL_AtomicInt quit;
+} PipelineRegistry;
+
+// Hot reload is disabled when directory cannot be watched
+bool pipeline_registry_init(PipelineRegistry* registry, SDL_GPUDevice* device, const char* directory);
+
+// Stops the rebuild worker and releases every pipeline, must run before the
+// device is destroyed
+void pipeline_registry_shutdown(PipelineRegistry* registry);
+
+// Returns the pipeline matching desc, building it on the calling thread the
+// first time it is asked for. Returns 0 if it could not be built.
+PipelineId pipeline_registry_find_or_create(PipelineRegistry* registry, const PipelineDesc* desc);
+
+// Called by the render thread at the start of a frame: picks up shader
+// changes and swaps in the pipelines rebuilt since the last call
+void pipeline_registry_update(PipelineRegistry* registry);
+
+SDL_GPUGraphicsPipeline* pipeline_registry_get(PipelineRegistry* registry, PipelineId id);
+
+typedef struct {
+    const char* shader;
+    Uint32 readonly_storage_buffers;
+    Uint32 readwrite_storage_buffers;
+    Uint32 uniform_buffers;
+    // Must match local_size_x in the shader
+    Uint32 threadcount_x;
+} ComputePipelineDesc;
+
+// Loads a compute pipeline from the registry directory. Compute pipelines are
+// owned by the caller and not hot reloaded.
+SDL_GPUComputePipeline* pipeline_registry_create_compute(PipelineRegistry* registry, const ComputePipelineDesc* desc);
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
@@ -47,26 +48,120 @@ struct MeshData {
     size_t indices_count;
 };
 
+enum class TextureFormat {
+    RGBA8,
+    // 4x4 blocks of 8 bytes, 1-bit alpha
+    BC1,
+    // 4x4 blocks of 16 bytes, interpolated alpha
+    BC3,
+};
+
+// Size in bytes of one mip level, block compressed levels are rounded up to
+// whole 4x4 blocks
+inline size_t texture_level_size(TextureFormat format, uint32_t width, uint32_t height)
+{
+    switch (format) {
+    case TextureFormat::BC1:
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 8;
+    case TextureFormat::BC3:
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+    default:
+        return (size_t)width * height * 4;
+    }
+}
+
+// A texture with its full mip chain, levels stored largest first and tightly
+// packed one after the other
+struct TextureData {
+    TextureFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_count;
+
+    const uint8_t* data;
+    size_t size;
+};
+
 typedef enum {
-    TODO
+    MATERIAL_FLAGS_NONE = 0,
+    // Fragments whose albedo alpha is below one half are discarded. Drawn
+    // after the opaque materials and left out of the depth pre-pass.
+    MATERIAL_FLAG_ALPHA_TEST = 1 << 0,
 } MaterialFlags;
 
 #define LOAD_ENTIRE_FILE(name) void*(name)(const char* file, size_t* datasize)
 typedef LOAD_ENTIRE_FILE(LoadEntireFileFn);
 
+// Releases a buffer returned by load_entire_file
+#define FREE_FILE(name) void(name)(void* data)
+typedef FREE_FILE(FreeFileFn);
+
 #define CREATE_MESH(name) MeshHandle(name)(MeshData * mesh_data)
 typedef CREATE_MESH(CreateMeshFn);
 
+#define CREATE_MESHES(name) void(name)(MeshData * mesh_datas, size_t count, MeshHandle * out_handles)
+typedef CREATE_MESHES(CreateMeshesFn);
+
+// The mip chain of RGBA textures is generated on the GPU
 #define CREATE_TEXTURE(name) TextureHandle(name)(const uint8_t* rgba_data, int width, int height)
 typedef CREATE_TEXTURE(CreateTextureFn);
 
+#define CREATE_TEXTURE_FROM_DATA(name) TextureHandle(name)(const TextureData* texture_data)
+typedef CREATE_TEXTURE_FROM_DATA(CreateTextureFromDataFn);
+
+#define IS_TEXTURE_FORMAT_SUPPORTED(name) bool(name)(TextureFormat format)
+typedef IS_TEXTURE_FORMAT_SUPPORTED(IsTextureFormatSupportedFn);
+
+#define DESTROY_MESH(name) void(name)(MeshHandle handle)
+typedef DESTROY_MESH(DestroyMeshFn);
+
+#define DESTROY_TEXTURE(name) void(name)(TextureHandle handle)
+typedef DESTROY_TEXTURE(DestroyTextureFn);
+
+#define IS_MESH_READY(name) bool(name)(MeshHandle handle)
+typedef IS_MESH_READY(IsMeshReadyFn);
+
+#define IS_TEXTURE_READY(name) bool(name)(TextureHandle handle)
+typedef IS_TEXTURE_READY(IsTextureReadyFn);
+
+// Geometry the game rewrites as often as every frame, drawn like any other
+// mesh and destroyed with destroy_mesh. Nothing is drawn until the first commit.
+#define CREATE_DYNAMIC_MESH(name) MeshHandle(name)(uint32_t max_vertices, uint32_t max_indices)
+typedef CREATE_DYNAMIC_MESH(CreateDynamicMeshFn);
+
+// Points out_mesh_data at memory to write the next contents into, its counts
+// are the capacity. Only one thread may map and commit a given mesh.
+#define MAP_DYNAMIC_MESH(name) bool(name)(MeshHandle handle, MeshData * out_mesh_data)
+typedef MAP_DYNAMIC_MESH(MapDynamicMeshFn);
+
+// Publishes what was written since the map, the renderer draws the latest
+// commit it has seen when it plays a frame
+#define COMMIT_DYNAMIC_MESH(name) void(name)(MeshHandle handle, uint32_t vertices_count, uint32_t indices_count)
+typedef COMMIT_DYNAMIC_MESH(CommitDynamicMeshFn);
+
+// An invalid albedo draws untextured. Materials live as long as the renderer.
 #define CREATE_MATERIAL(name) MaterialHandle(name)(TextureHandle albedo, MaterialFlags flags)
 typedef CREATE_MATERIAL(CreateMaterialFn);
 
+// Resource creation can be called from any thread. Handles are usable right
+// away, draws referencing them are skipped until the upload has completed.
+// A destroyed handle is still drawn by the draw list being built and the one
+// being played, after that it is stale and drawing it is a no-op.
 struct Api {
     LoadEntireFileFn* load_entire_file;
+    FreeFileFn* free_file;
     CreateMeshFn* create_mesh;
+    CreateMeshesFn* create_meshes;
     CreateTextureFn* create_texture;
+    CreateTextureFromDataFn* create_texture_from_data;
+    IsTextureFormatSupportedFn* is_texture_format_supported;
+    DestroyMeshFn* destroy_mesh;
+    DestroyTextureFn* destroy_texture;
+    IsMeshReadyFn* is_mesh_ready;
+    IsTextureReadyFn* is_texture_ready;
+    CreateDynamicMeshFn* create_dynamic_mesh;
+    MapDynamicMeshFn* map_dynamic_mesh;
+    CommitDynamicMeshFn* commit_dynamic_mesh;
     CreateMaterialFn* create_material;
 };
 
@@ -76,34 +171,211 @@ struct Transform {
     glm::vec3 scale = glm::vec3(1.0f);
 };
 
-enum class DrawCommandType {
+enum class DrawCommandType : uint32_t {
     Invalid,
     DrawMesh,
+    // Same as DrawMesh with a model matrix the game already computed
+    DrawMeshMatrix,
+    // World space lines, all of a frame's are drawn together. Only produced
+    // and drawn in builds with ALMOND_DEBUG_DRAW.
+    DebugLines,
 };
 
-struct DrawCommand {
-    DrawCommandType type = DrawCommandType::Invalid;
-    union {
-        struct {
-            MeshHandle mesh;
-            TextureHandle texture;
-            Transform transform;
-        } draw_mesh;
-        struct {
-            MeshHandle mesh;
-            Transform transform;
-        } debug_collider;
-    } as;
+// Draw lists are a stream of variable-size commands: a header followed by the
+// payload struct of its type, padded to DRAW_COMMAND_ALIGNMENT. A new command
+// type only needs an enum value and a payload struct.
+#define DRAW_COMMAND_ALIGNMENT 8
+
+struct DrawCommandHeader {
+    DrawCommandType type;
+    // Header and payload, padding included
+    uint32_t size;
+};
+
+// An invalid material draws with the untextured default
+struct DrawMeshCommand {
+    MeshHandle mesh;
+    MaterialHandle material;
+    Transform transform;
 };
 
+struct DrawMeshMatrixCommand {
+    MeshHandle mesh;
+    MaterialHandle material;
+    glm::mat4 model_matrix;
+};
+
+// Color is RGBA8, red in the lowest byte
+struct DebugVertex {
+    glm::vec3 position;
+    uint32_t color;
+};
+
+// Followed by vertex_count vertices, two per line
+struct DebugLinesCommand {
+    uint32_t vertex_count;
+    uint32_t padding;
+};
+
+template<typename T>
+inline const T* draw_command_payload(const DrawCommandHeader* header)
+{
+    return (const T*)(header + 1);
+}
+
+// What the renderer did with the last played draw list. Times are CPU
+// milliseconds on the render thread.
+struct RenderStats {
+    uint32_t draw_calls;
+    uint32_t instances;
+    uint32_t triangles;
+
+    // Bind and uniform push calls that reached the GPU API and those filtered
+    // as redundant
+    uint32_t binds;
+    uint32_t binds_skipped;
+    uint32_t uniform_bytes;
+
+    // Resource uploads and per-draw data copied to the GPU
+    uint64_t upload_bytes;
+
+    // State changes the draws would need in submission order and once sorted
+    uint32_t state_changes_unsorted;
+    uint32_t state_changes_sorted;
+
+    float record_ms;
+    float submit_ms;
+    float swapchain_wait_ms;
+
+    // From the last input the camera saw, late latched or sampled before
+    // game_iterate, to submission. Presentation adds at least one refresh.
+    float input_latency_ms;
+};
+
+// Commands are written linearly into pages, the page header is followed by
+// capacity bytes of commands
+struct DrawListPage {
+    DrawListPage* next;
+    size_t used;
+    size_t capacity;
+};
+
+#define DRAW_LIST_PAGE_SIZE (64 * 1024)
+
+// Returns a page with room for at least min_capacity bytes, NULL when out of memory
+#define ALLOCATE_DRAW_LIST_PAGE(name) DrawListPage*(name)(size_t min_capacity)
+typedef ALLOCATE_DRAW_LIST_PAGE(AllocateDrawListPageFn);
+
+#define LATE_LATCH_DATA_SIZE 64
+
 struct DrawList {
     glm::vec4 clear_color;
     Camera camera;
-    DrawCommand* commands;
+
+    // Whatever the game's late_latch_camera export needs to rebuild the
+    // camera, copied here because game state moves on while the list renders
+    uint8_t late_latch_data[LATE_LATCH_DATA_SIZE];
+
+    // Set by the platform when it samples input for game_iterate: the time
+    // and the mouse movement accumulated since startup
+    uint64_t input_ticks;
+    glm::vec2 input_mouse_total;
+
+    // Pages are kept when the list is reset and reused in order, the list
+    // grows by another page once they are all full
+    DrawListPage* first_page;
+    DrawListPage* current_page;
+    AllocateDrawListPageFn* allocate_page;
     size_t count;
-    size_t capacity;
+
+    // Written by the renderer once the list is played. Lists are recycled,
+    // so the game sees the stats of the last frame played from this one.
+    RenderStats stats;
+};
+
+inline void draw_list_reset(DrawList* draw_list)
+{
+    draw_list->count = 0;
+    draw_list->current_page = draw_list->first_page;
+
+    if (draw_list->current_page) {
+        draw_list->current_page->used = 0;
+    }
+}
+
+// Appends a command and returns its zeroed payload, NULL when no page could
+// be allocated
+inline void* draw_list_push(DrawList* draw_list, DrawCommandType type, size_t payload_size)
+{
+    size_t size = (sizeof(DrawCommandHeader) + payload_size + DRAW_COMMAND_ALIGNMENT - 1) & ~(size_t)(DRAW_COMMAND_ALIGNMENT - 1);
+    DrawListPage* page = draw_list->current_page;
+
+    while (!page || page->used + size > page->capacity) {
+        if (page && page->next) {
+            page = page->next;
+            page->used = 0;
+            continue;
+        }
+
+        DrawListPage* new_page = draw_list->allocate_page(size > DRAW_LIST_PAGE_SIZE ? size : DRAW_LIST_PAGE_SIZE);
+        if (!new_page) {
+            return NULL;
+        }
+
+        new_page->next = NULL;
+        new_page->used = 0;
+
+        if (page) {
+            page->next = new_page;
+        } else {
+            draw_list->first_page = new_page;
+        }
+
+        page = new_page;
+    }
+
+    draw_list->current_page = page;
+
+    auto* header = (DrawCommandHeader*)((uint8_t*)(page + 1) + page->used);
+    header->type = type;
+    header->size = (uint32_t)size;
+    memset(header + 1, 0, size - sizeof(DrawCommandHeader));
+
+    page->used += size;
+    draw_list->count++;
+
+    return header + 1;
+}
+
+struct DrawListIterator {
+    const DrawListPage* page;
+    size_t offset;
 };
 
+inline DrawListIterator draw_list_begin(const DrawList* draw_list)
+{
+    return { draw_list->count > 0 ? draw_list->first_page : NULL, 0 };
+}
+
+// Returns the next command in submission order, NULL once all were visited.
+// Pages past current_page hold stale commands of earlier frames.
+inline const DrawCommandHeader* draw_list_next(const DrawList* draw_list, DrawListIterator* it)
+{
+    while (it->page && it->offset >= it->page->used) {
+        it->page = it->page == draw_list->current_page ? NULL : it->page->next;
+        it->offset = 0;
+    }
+
+    if (!it->page) {
+        return NULL;
+    }
+
+    auto* header = (const DrawCommandHeader*)((const uint8_t*)(it->page + 1) + it->offset);
+    it->offset += header->size;
+
+    return header;
+}
+
 struct GameMemory {
     bool is_initialized;
 
@@ -127,17 +399,25 @@ typedef struct {
     glm::vec2 right_stick;
 
     union {
-        GameButtonState buttons[5];
+        GameButtonState buttons[6];
         struct {
             GameButtonState move_up;
             GameButtonState move_down;
             GameButtonState move_right;
             GameButtonState move_left;
             GameButtonState move_jump;
+            GameButtonState toggle_debug_draw;
         };
     };
 
 } ControllerInput;
 
+// Optional game export. Rebuilds the camera of a draw list from its
+// late_latch_data and the mouse movement that arrived after game_iterate
+// sampled input. Runs on the render thread right before submission, so it
+// must be cheap and must not touch game memory.
+#define LATE_LATCH_CAMERA(name) Camera(name)(const uint8_t* late_latch_data, glm::vec2 mouse_delta)
+typedef LATE_LATCH_CAMERA(LateLatchCameraFn);
+
 #define GAME_ITERATE(name) void(name)(GameMemory * memory, ControllerInput* input, DrawList * draw_list, float dt, Api * api)
 typedef GAME_ITERATE(GameIterateFn);
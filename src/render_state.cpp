@@ -0,0 +1,115 @@
+#include "render_state.h"
+
+void render_state_begin(RenderState* state, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass)
+{
+    BindStats stats = state->stats;
+
+    SDL_zerop(state);
+    state->command_buffer = command_buffer;
+    state->render_pass = render_pass;
+    state->stats = stats;
+}
+
+void render_state_reset_stats(RenderState* state)
+{
+    SDL_zero(state->stats);
+}
+
+void render_state_bind_pipeline(RenderState* state, SDL_GPUGraphicsPipeline* pipeline)
+{
+    if (state->pipeline == pipeline) {
+        state->stats.skipped++;
+        return;
+    }
+
+    SDL_BindGPUGraphicsPipeline(state->render_pass, pipeline);
+    state->pipeline = pipeline;
+    state->stats.issued++;
+}
+
+void render_state_bind_vertex_buffer(RenderState* state, SDL_GPUBuffer* buffer, Uint32 offset)
+{
+    if (state->vertex_buffer.buffer == buffer && state->vertex_buffer.offset == offset) {
+        state->stats.skipped++;
+        return;
+    }
+
+    SDL_GPUBufferBinding binding = {
+        .buffer = buffer,
+        .offset = offset,
+    };
+
+    SDL_BindGPUVertexBuffers(state->render_pass, 0, &binding, 1);
+    state->vertex_buffer = { buffer, offset };
+    state->stats.issued++;
+}
+
+void render_state_bind_index_buffer(RenderState* state, SDL_GPUBuffer* buffer, Uint32 offset, SDL_GPUIndexElementSize element_size)
+{
+    if (state->index_buffer.buffer == buffer && state->index_buffer.offset == offset && state->index_element_size == element_size) {
+        state->stats.skipped++;
+        return;
+    }
+
+    SDL_GPUBufferBinding binding = {
+        .buffer = buffer,
+        .offset = offset,
+    };
+
+    SDL_BindGPUIndexBuffer(state->render_pass, &binding, element_size);
+    state->index_buffer = { buffer, offset };
+    state->index_element_size = element_size;
+    state->stats.issued++;
+}
+
+void render_state_bind_vertex_storage_buffer(RenderState* state, Uint32 slot, SDL_GPUBuffer* buffer)
+{
+    if (state->vertex_storage_buffers[slot] == buffer) {
+        state->stats.skipped++;
+        return;
+    }
+
+    SDL_BindGPUVertexStorageBuffers(state->render_pass, slot, &buffer, 1);
+    state->vertex_storage_buffers[slot] = buffer;
+    state->stats.issued++;
+}
+
+void render_state_bind_fragment_sampler(RenderState* state, SDL_GPUTexture* texture, SDL_GPUSampler* sampler)
+{
+    if (state->fragment_sampler.texture == texture && state->fragment_sampler.sampler == sampler) {
+        state->stats.skipped++;
+        return;
+    }
+
+    SDL_GPUTextureSamplerBinding binding = {
+        .texture = texture,
+        .sampler = sampler,
+    };
+
+    SDL_BindGPUFragmentSamplers(state->render_pass, 0, &binding, 1);
+    state->fragment_sampler = binding;
+    state->stats.issued++;
+}
+
+void render_state_push_vertex_uniforms(RenderState* state, Uint32 slot, const void* data, Uint32 size)
+{
+    SDL_assert(slot < RENDER_STATE_UNIFORM_SLOTS);
+
+    BoundUniforms* bound = &state->vertex_uniforms[slot];
+
+    if (bound->size == size && SDL_memcmp(bound->data, data, size) == 0) {
+        state->stats.skipped++;
+        return;
+    }
+
+    SDL_PushGPUVertexUniformData(state->command_buffer, slot, data, size);
+    state->stats.issued++;
+    state->stats.uniform_bytes += size;
+
+    if (size <= RENDER_STATE_MAX_UNIFORM_SIZE) {
+        SDL_memcpy(bound->data, data, size);
+        bound->size = size;
+    } else {
+        bound->size = 0;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <SDL3/SDL_gpu.h>
+
+#define RENDER_STATE_UNIFORM_SLOTS 4
+#define RENDER_STATE_STORAGE_SLOTS 2
+#define RENDER_STATE_MAX_UNIFORM_SIZE 256
+
+typedef struct {
+    Uint32 issued;
+    Uint32 skipped;
+    Uint32 uniform_bytes;
+} BindStats;
+
+typedef struct {
+    SDL_GPUBuffer* buffer;
+    Uint32 offset;
+} BoundBuffer;
+
+typedef struct {
+    Uint8 data[RENDER_STATE_MAX_UNIFORM_SIZE];
+    Uint32 size;
+} BoundUniforms;
+
+// Remembers what is bound in the current render pass and drops bind calls
+// that would not change anything. Uniforms are compared by content, larger
+// blocks than RENDER_STATE_MAX_UNIFORM_SIZE are always pushed.
+typedef struct {
+    SDL_GPUCommandBuffer* command_buffer;
+    SDL_GPURenderPass* render_pass;
+
+    SDL_GPUGraphicsPipeline* pipeline;
+    BoundBuffer vertex_buffer;
+    BoundBuffer index_buffer;
+    SDL_GPUIndexElementSize index_element_size;
+    SDL_GPUBuffer* vertex_storage_buffers[RENDER_STATE_STORAGE_SLOTS];
+    SDL_GPUTextureSamplerBinding fragment_sampler;
+    BoundUniforms vertex_uniforms[RENDER_STATE_UNIFORM_SLOTS];
+
+    BindStats stats;
+} RenderState;
+
+// Forgets all bindings, SDL does not carry them over between render passes.
+// Stats keep accumulating until render_state_reset_stats.
+void render_state_begin(RenderState* state, SDL_GPUCommandBuffer* command_buffer, SDL_GPURenderPass* render_pass);
+void render_state_reset_stats(RenderState* state);
+
+void render_state_bind_pipeline(RenderState* state, SDL_GPUGraphicsPipeline* pipeline);
+void render_state_bind_vertex_buffer(RenderState* state, SDL_GPUBuffer* buffer, Uint32 offset);
+void render_state_bind_index_buffer(RenderState* state, SDL_GPUBuffer* buffer, Uint32 offset, SDL_GPUIndexElementSize element_size);
+void render_state_bind_vertex_storage_buffer(RenderState* state, Uint32 slot, SDL_GPUBuffer* buffer);
+void render_state_bind_fragment_sampler(RenderState* state, SDL_GPUTexture* texture, SDL_GPUSampler* sampler);
+void render_state_push_vertex_uniforms(RenderState* state, Uint32 slot, const void* data, Uint32 size);
@@ -1,382 +1,2716 @@
 #include "renderer.h"
 
 #include "logger.h"
+#include "transform_batch.h"
 
 #include <SDL3/SDL_gpu.h>
-#include <SDL3/SDL_log.h>
+
+#define RENDERER_NEAR_PLANE 1.0f
+#define RENDERER_FAR_PLANE 4096.0f
 
 typedef struct {
     glm::mat4 proj_view_matrix;
-    glm::mat4 model_matrix;
 } VertexUniforms;
 
-static SDL_GPUShader* load_shader(SDL_GPUDevice* device, const char* path, SDL_GPUShaderStage stage,
-    int num_uniform_buffers, int num_samplers)
+#define STAGING_RING_SIZE (32 * 1024 * 1024)
+#define STAGING_ALIGNMENT 16
+
+static bool staging_init(Renderer* renderer)
+{
+    StagingRing* staging = &renderer->staging;
+
+    SDL_GPUTransferBufferCreateInfo transfer_info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = STAGING_RING_SIZE,
+    };
+
+    staging->transfer_buffer = SDL_CreateGPUTransferBuffer(renderer->device, &transfer_info);
+    if (!staging->transfer_buffer) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    staging->size = STAGING_RING_SIZE;
+    staging->batch = 1;
+    SDL_SetAtomicU32(&staging->completed_batch, 0);
+    staging->head = 0;
+    staging->batch_begin = 0;
+    staging->mapped = NULL;
+    staging->alloc_buffer = staging->transfer_buffer;
+    staging->dedicated_count = 0;
+    staging->dedicated_mapped = NULL;
+    staging->pending_count = 0;
+    staging->submissions_count = 0;
+
+    return true;
+}
+
+static void staging_retire_oldest(Renderer* renderer)
+{
+    StagingRing* staging = &renderer->staging;
+
+    SDL_WaitForGPUFences(renderer->device, true, &staging->submissions[0].fence, 1);
+    SDL_ReleaseGPUFence(renderer->device, staging->submissions[0].fence);
+
+    SDL_SetAtomicU32(&staging->completed_batch, staging->submissions[0].batch);
+
+    staging->submissions_count--;
+    memmove(staging->submissions, staging->submissions + 1, staging->submissions_count * sizeof(StagingSubmission));
+}
+
+// Returns false when the copies could not be submitted. They then stay
+// pending, with the batch their resources were stamped with, and go out with
+// the next flush that succeeds.
+static bool staging_flush(Renderer* renderer)
+{
+    StagingRing* staging = &renderer->staging;
+
+    if (staging->mapped) {
+        SDL_UnmapGPUTransferBuffer(renderer->device, staging->transfer_buffer);
+        staging->mapped = NULL;
+    }
+
+    if (staging->dedicated_mapped) {
+        SDL_UnmapGPUTransferBuffer(renderer->device, staging->dedicated_mapped);
+        staging->dedicated_mapped = NULL;
+    }
+
+    if (staging->pending_count == 0) {
+        return true;
+    }
+
+    SDL_GPUCommandBuffer* command_buffer = SDL_AcquireGPUCommandBuffer(renderer->device);
+    if (!command_buffer) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
+
+    for (size_t i = 0; i < staging->pending_count; i++) {
+        PendingUpload* upload = &staging->pending[i];
+
+        switch (upload->type) {
+        case PENDING_UPLOAD_BUFFER: {
+            SDL_GPUTransferBufferLocation location = {
+                .transfer_buffer = upload->transfer_buffer,
+                .offset = upload->staging_offset,
+            };
+
+            SDL_GPUBufferRegion region = {
+                .buffer = upload->buffer,
+                .offset = upload->buffer_offset,
+                .size = upload->size,
+            };
+
+            SDL_UploadToGPUBuffer(copy_pass, &location, &region, false);
+        } break;
+        case PENDING_UPLOAD_TEXTURE: {
+            // Tightly packed rows, which for block formats means whole blocks
+            SDL_GPUTextureTransferInfo transfer_info = {
+                .transfer_buffer = upload->transfer_buffer,
+                .offset = upload->staging_offset,
+                .pixels_per_row = 0,
+                .rows_per_layer = 0,
+            };
+
+            SDL_GPUTextureRegion region = {
+                .texture = upload->texture,
+                .mip_level = upload->mip_level,
+                .layer = upload->layer,
+                .w = upload->width,
+                .h = upload->height,
+                .d = 1,
+            };
+
+            SDL_UploadToGPUTexture(copy_pass, &transfer_info, &region, false);
+        } break;
+        }
+    }
+
+    SDL_EndGPUCopyPass(copy_pass);
+
+    for (size_t i = 0; i < staging->pending_count; i++) {
+        PendingUpload* upload = &staging->pending[i];
+
+        if (upload->type == PENDING_UPLOAD_TEXTURE && upload->generate_mips) {
+            SDL_GenerateMipmapsForGPUTexture(command_buffer, upload->texture);
+        }
+    }
+
+    SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(command_buffer);
+
+    // SDL keeps them alive until the copies above have completed
+    for (size_t i = 0; i < staging->dedicated_count; i++) {
+        SDL_ReleaseGPUTransferBuffer(renderer->device, staging->dedicated[i]);
+    }
+
+    staging->dedicated_count = 0;
+
+    if (staging->submissions_count == STAGING_MAX_SUBMISSIONS) {
+        staging_retire_oldest(renderer);
+    }
+
+    staging->submissions[staging->submissions_count++] = {
+        .fence = fence,
+        .batch = staging->batch,
+        .begin = staging->batch_begin,
+        .end = staging->head,
+    };
+
+    staging->pending_count = 0;
+    staging->batch_begin = staging->head;
+    staging->batch++;
+
+    return true;
+}
+
+// Retires every submission whose copies have finished without blocking
+static void staging_poll(Renderer* renderer)
+{
+    StagingRing* staging = &renderer->staging;
+
+    while (staging->submissions_count > 0 && SDL_QueryGPUFence(renderer->device, staging->submissions[0].fence)) {
+        staging_retire_oldest(renderer);
+    }
+}
+
+// Creates a transfer buffer for one upload that does not fit in the ring
+static uint8_t* staging_alloc_dedicated(Renderer* renderer, Uint32 size, Uint32* out_offset)
 {
-    size_t shader_code_size;
-    void* shader_code = SDL_LoadFile(path, &shader_code_size);
+    StagingRing* staging = &renderer->staging;
+
+    if (staging->dedicated_count == STAGING_MAX_DEDICATED_BUFFERS && !staging_flush(renderer)) {
+        return NULL;
+    }
+
+    SDL_GPUTransferBufferCreateInfo transfer_info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = size,
+    };
 
-    if (!shader_code)
+    SDL_GPUTransferBuffer* transfer_buffer = SDL_CreateGPUTransferBuffer(renderer->device, &transfer_info);
+    if (!transfer_buffer) {
+        log_err("%s", SDL_GetError());
         return NULL;
+    }
 
-    SDL_GPUShaderCreateInfo create_info = {};
-    create_info.code = (Uint8*)shader_code;
-    create_info.code_size = shader_code_size;
-    create_info.entrypoint = "main";
-    create_info.format = SDL_GPU_SHADERFORMAT_SPIRV;
-    create_info.stage = stage;
-    create_info.num_samplers = num_samplers;
-    create_info.num_storage_buffers = 0;
-    create_info.num_storage_textures = 0;
-    create_info.num_uniform_buffers = num_uniform_buffers;
+    auto* mapped = (uint8_t*)SDL_MapGPUTransferBuffer(renderer->device, transfer_buffer, false);
+    if (!mapped) {
+        log_err("%s", SDL_GetError());
+        SDL_ReleaseGPUTransferBuffer(renderer->device, transfer_buffer);
+        return NULL;
+    }
 
-    SDL_GPUShader* shader = SDL_CreateGPUShader(device, &create_info);
+    staging->dedicated[staging->dedicated_count++] = transfer_buffer;
+    staging->dedicated_mapped = transfer_buffer;
+    staging->alloc_buffer = transfer_buffer;
+    *out_offset = 0;
 
-    SDL_free(shader_code);
+    renderer->stats.upload_bytes += size;
 
-    return shader;
+    return mapped;
 }
 
-bool renderer_init(Renderer* renderer, SDL_Window* window)
+// Reserves size bytes at the head of the ring and returns a CPU pointer to
+// them, flushing and waiting on in-flight copies when the ring is exhausted.
+// The pointer is valid until the next allocation.
+static uint8_t* staging_alloc(Renderer* renderer, Uint32 size, Uint32* out_offset)
 {
-    renderer->window = window;
+    StagingRing* staging = &renderer->staging;
 
-    renderer->device = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, true, "vulkan");
+    // The previous dedicated buffer was written by now
+    if (staging->dedicated_mapped) {
+        SDL_UnmapGPUTransferBuffer(renderer->device, staging->dedicated_mapped);
+        staging->dedicated_mapped = NULL;
+    }
 
-    if (!SDL_ClaimWindowForGPUDevice(renderer->device, renderer->window)) {
+    if (staging->pending_count == STAGING_MAX_PENDING_UPLOADS && !staging_flush(renderer)) {
+        return NULL;
+    }
+
+    if (size > staging->size) {
+        return staging_alloc_dedicated(renderer, size, out_offset);
+    }
+
+    Uint32 offset = (staging->head + STAGING_ALIGNMENT - 1) & ~(Uint32)(STAGING_ALIGNMENT - 1);
+
+    // Wrapping would overwrite copies that are still pending
+    if (offset + size > staging->size) {
+        if (!staging_flush(renderer)) {
+            return NULL;
+        }
+
+        offset = 0;
+        staging->head = 0;
+        staging->batch_begin = 0;
+    }
+
+    // Wait for the copies still reading from the region we are about to overwrite
+    for (;;) {
+        bool overlaps = false;
+
+        for (size_t i = 0; i < staging->submissions_count; i++) {
+            StagingSubmission* submission = &staging->submissions[i];
+
+            if (submission->begin < offset + size && offset < submission->end) {
+                overlaps = true;
+                break;
+            }
+        }
+
+        if (!overlaps) {
+            break;
+        }
+
+        staging_retire_oldest(renderer);
+    }
+
+    if (!staging->mapped) {
+        staging->mapped = (uint8_t*)SDL_MapGPUTransferBuffer(renderer->device, staging->transfer_buffer, false);
+        if (!staging->mapped) {
+            log_err("%s", SDL_GetError());
+            return NULL;
+        }
+    }
+
+    staging->head = offset + size;
+    staging->alloc_buffer = staging->transfer_buffer;
+    *out_offset = offset;
+
+    renderer->stats.upload_bytes += size;
+
+    return staging->mapped + offset;
+}
+
+static PendingUpload* staging_push_upload(Renderer* renderer)
+{
+    PendingUpload* upload = &renderer->staging.pending[renderer->staging.pending_count++];
+    upload->transfer_buffer = renderer->staging.alloc_buffer;
+
+    return upload;
+}
+
+#define MESH_POOL_INITIAL_VERTICES (256 * 1024)
+#define MESH_POOL_INITIAL_INDICES (1024 * 1024)
+
+// The creating thread publishes the DynamicMesh before the handle escapes,
+// the render thread reads it for every mesh, queued or not
+static DynamicMesh* mesh_dynamic(MeshResource* mesh_resource)
+{
+    return (DynamicMesh*)SDL_GetAtomicPointer(&mesh_resource->dynamic);
+}
+
+static void mesh_set_dynamic(MeshResource* mesh_resource, DynamicMesh* dynamic)
+{
+    SDL_SetAtomicPointer(&mesh_resource->dynamic, dynamic);
+}
+
+static bool mesh_pool_create_buffers(Renderer* renderer, Uint32 vertex_capacity, Uint32 index_capacity,
+    SDL_GPUBuffer** out_vertex_buffer, SDL_GPUBuffer** out_position_buffer, SDL_GPUBuffer** out_index_buffer)
+{
+    SDL_GPUBufferCreateInfo vertex_buffer_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
+        .size = vertex_capacity * (Uint32)sizeof(Vertex),
+    };
+
+    *out_vertex_buffer = SDL_CreateGPUBuffer(renderer->device, &vertex_buffer_create_info);
+    if (!*out_vertex_buffer) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    SDL_GPUBufferCreateInfo position_buffer_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
+        .size = vertex_capacity * (Uint32)sizeof(glm::vec3),
+    };
+
+    *out_position_buffer = SDL_CreateGPUBuffer(renderer->device, &position_buffer_create_info);
+    if (!*out_position_buffer) {
+        log_err("%s", SDL_GetError());
+        SDL_ReleaseGPUBuffer(renderer->device, *out_vertex_buffer);
+        return false;
+    }
+
+    SDL_GPUBufferCreateInfo index_buffer_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_INDEX,
+        .size = index_capacity * (Uint32)sizeof(uint16_t),
+    };
+
+    *out_index_buffer = SDL_CreateGPUBuffer(renderer->device, &index_buffer_create_info);
+    if (!*out_index_buffer) {
+        log_err("%s", SDL_GetError());
+        SDL_ReleaseGPUBuffer(renderer->device, *out_position_buffer);
+        SDL_ReleaseGPUBuffer(renderer->device, *out_vertex_buffer);
+        return false;
+    }
+
+    return true;
+}
+
+static bool mesh_pool_init(Renderer* renderer)
+{
+    MeshPool* pool = &renderer->mesh_pool;
+
+    if (!mesh_pool_create_buffers(renderer, MESH_POOL_INITIAL_VERTICES, MESH_POOL_INITIAL_INDICES,
+            &pool->vertex_buffer, &pool->position_buffer, &pool->index_buffer)) {
+        return false;
+    }
+
+    if (!offset_allocator_init(&pool->vertex_allocator, MESH_POOL_INITIAL_VERTICES)
+        || !offset_allocator_init(&pool->index_allocator, MESH_POOL_INITIAL_INDICES)) {
+        log_err("Could not create mesh pool allocators");
+        return false;
+    }
+
+    return true;
+}
+
+// Moves every resident mesh into freshly created buffers of the given capacity,
+// packed back to back. Used both to compact a fragmented pool and to grow it.
+static bool mesh_pool_rebuild(Renderer* renderer, Uint32 vertex_capacity, Uint32 index_capacity)
+{
+    MeshPool* pool = &renderer->mesh_pool;
+
+    SDL_GPUBuffer* vertex_buffer;
+    SDL_GPUBuffer* position_buffer;
+    SDL_GPUBuffer* index_buffer;
+
+    if (!mesh_pool_create_buffers(renderer, vertex_capacity, index_capacity, &vertex_buffer, &position_buffer, &index_buffer)) {
+        return false;
+    }
+
+    // Pending uploads target the old buffers, submit them before copying out
+    SDL_GPUCommandBuffer* command_buffer = staging_flush(renderer) ? SDL_AcquireGPUCommandBuffer(renderer->device) : NULL;
+    if (!command_buffer) {
         log_err("%s", SDL_GetError());
+        SDL_ReleaseGPUBuffer(renderer->device, index_buffer);
+        SDL_ReleaseGPUBuffer(renderer->device, position_buffer);
+        SDL_ReleaseGPUBuffer(renderer->device, vertex_buffer);
+        return false;
+    }
+
+    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
+
+    offset_allocator_reset(&pool->vertex_allocator, vertex_capacity);
+    offset_allocator_reset(&pool->index_allocator, index_capacity);
+
+    // Ranges awaiting release only exist in the old buffers, which SDL keeps
+    // alive for the frames still reading them
+    DeferredReleaseQueue* deferred = &renderer->deferred_releases;
+    for (size_t i = 0; i < deferred->count;) {
+        if (deferred->releases[i].type == DEFERRED_RELEASE_MESH) {
+            deferred->releases[i] = deferred->releases[--deferred->count];
+        } else {
+            i++;
+        }
+    }
+
+    for (size_t i = 0; i < MESH_STORAGE_CAPACITY; i++) {
+        MeshResource* mesh = &renderer->mesh_storage.meshes[i];
+        DynamicMesh* dynamic = mesh_dynamic(mesh);
+
+        Uint32 source_vertex_offset = mesh->vertex_offset;
+        Uint32 source_first_index = mesh->first_index;
+        Uint32 vertices_count = mesh->vertices_count;
+        Uint32 indices_count = mesh->indices_count;
+
+        // Dynamic meshes move with all of their regions
+        if (dynamic) {
+            if (!dynamic->resident) {
+                continue;
+            }
+
+            source_vertex_offset = dynamic->vertex_base;
+            source_first_index = dynamic->index_base;
+            vertices_count = dynamic->max_vertices * DRAW_DATA_RING_FRAMES;
+            indices_count = dynamic->max_indices * DRAW_DATA_RING_FRAMES;
+        } else if (mesh->indices_count == 0) {
+            continue;
+        }
+
+        Uint32 vertex_offset;
+        Uint32 first_index;
+        offset_allocator_alloc(&pool->vertex_allocator, vertices_count, &vertex_offset);
+        offset_allocator_alloc(&pool->index_allocator, indices_count, &first_index);
+
+        SDL_GPUBufferLocation vertex_source = {
+            .buffer = pool->vertex_buffer,
+            .offset = source_vertex_offset * (Uint32)sizeof(Vertex),
+        };
+
+        SDL_GPUBufferLocation vertex_destination = {
+            .buffer = vertex_buffer,
+            .offset = vertex_offset * (Uint32)sizeof(Vertex),
+        };
+
+        SDL_CopyGPUBufferToBuffer(copy_pass, &vertex_source, &vertex_destination, vertices_count * sizeof(Vertex), false);
+
+        SDL_GPUBufferLocation position_source = {
+            .buffer = pool->position_buffer,
+            .offset = source_vertex_offset * (Uint32)sizeof(glm::vec3),
+        };
+
+        SDL_GPUBufferLocation position_destination = {
+            .buffer = position_buffer,
+            .offset = vertex_offset * (Uint32)sizeof(glm::vec3),
+        };
+
+        SDL_CopyGPUBufferToBuffer(copy_pass, &position_source, &position_destination, vertices_count * sizeof(glm::vec3), false);
+
+        SDL_GPUBufferLocation index_source = {
+            .buffer = pool->index_buffer,
+            .offset = source_first_index * (Uint32)sizeof(uint16_t),
+        };
+
+        SDL_GPUBufferLocation index_destination = {
+            .buffer = index_buffer,
+            .offset = first_index * (Uint32)sizeof(uint16_t),
+        };
+
+        SDL_CopyGPUBufferToBuffer(copy_pass, &index_source, &index_destination, indices_count * sizeof(uint16_t), false);
+
+        if (dynamic) {
+            dynamic->vertex_base = vertex_offset;
+            dynamic->index_base = first_index;
+            vertex_offset += dynamic->region * dynamic->max_vertices;
+            first_index += dynamic->region * dynamic->max_indices;
+        }
+
+        mesh->vertex_offset = vertex_offset;
+        mesh->first_index = first_index;
+    }
+
+    SDL_EndGPUCopyPass(copy_pass);
+    SDL_SubmitGPUCommandBuffer(command_buffer);
+
+    // Releases are deferred by SDL until the copies above have completed
+    SDL_ReleaseGPUBuffer(renderer->device, pool->vertex_buffer);
+    SDL_ReleaseGPUBuffer(renderer->device, pool->position_buffer);
+    SDL_ReleaseGPUBuffer(renderer->device, pool->index_buffer);
+
+    pool->vertex_buffer = vertex_buffer;
+    pool->position_buffer = position_buffer;
+    pool->index_buffer = index_buffer;
+
+    return true;
+}
+
+static bool mesh_pool_alloc(Renderer* renderer, Uint32 vertices_count, Uint32 indices_count, Uint32* out_vertex_offset, Uint32* out_first_index)
+{
+    MeshPool* pool = &renderer->mesh_pool;
+
+    if (offset_allocator_largest_free_range(&pool->vertex_allocator) < vertices_count
+        || offset_allocator_largest_free_range(&pool->index_allocator) < indices_count) {
+        Uint32 vertex_capacity = pool->vertex_allocator.size;
+        Uint32 index_capacity = pool->index_allocator.size;
+
+        Uint32 vertices_used = vertex_capacity - pool->vertex_allocator.free_size;
+        Uint32 indices_used = index_capacity - pool->index_allocator.free_size;
+
+        // Compact when the space exists but is fragmented, grow otherwise
+        while (vertex_capacity - vertices_used < vertices_count) {
+            vertex_capacity *= 2;
+        }
+
+        while (index_capacity - indices_used < indices_count) {
+            index_capacity *= 2;
+        }
+
+        if (!mesh_pool_rebuild(renderer, vertex_capacity, index_capacity)) {
+            return false;
+        }
+    }
+
+    offset_allocator_alloc(&pool->vertex_allocator, vertices_count, out_vertex_offset);
+    offset_allocator_alloc(&pool->index_allocator, indices_count, out_first_index);
+
+    return true;
+}
+
+static bool upload_mesh(Renderer* renderer, UploadRequest* request)
+{
+    MeshResource* mesh_resource = &renderer->mesh_storage.meshes[slot_map_index(request->handle)];
+    MeshPool* pool = &renderer->mesh_pool;
+
+    Uint32 vertices_size = request->vertices_count * sizeof(Vertex);
+    Uint32 positions_size = request->vertices_count * sizeof(glm::vec3);
+    Uint32 bounds_size = sizeof(glm::vec4);
+    Uint32 indices_size = request->indices_count * sizeof(uint16_t);
+
+    Vertex* vertices = (Vertex*)request->data;
+    glm::vec3 bounds_min = vertices[0].position;
+    glm::vec3 bounds_max = vertices[0].position;
+
+    for (Uint32 i = 1; i < request->vertices_count; i++) {
+        bounds_min = glm::min(bounds_min, vertices[i].position);
+        bounds_max = glm::max(bounds_max, vertices[i].position);
+    }
+
+    mesh_resource->bounds_center = (bounds_min + bounds_max) * 0.5f;
+    mesh_resource->bounds_radius = glm::length(bounds_max - bounds_min) * 0.5f;
+
+    Uint32 vertex_offset;
+    Uint32 first_index;
+
+    if (!mesh_pool_alloc(renderer, request->vertices_count, request->indices_count, &vertex_offset, &first_index)) {
+        log_err("Mesh pool full");
+        return false;
+    }
+
+    // All uploads are reserved before any is recorded so a flush in between
+    // can never submit part of the mesh without the rest.
+    Uint32 staging_offset;
+    uint8_t* staging_data = NULL;
+
+    if (renderer->staging.pending_count + 4 <= STAGING_MAX_PENDING_UPLOADS || staging_flush(renderer)) {
+        staging_data = staging_alloc(renderer, vertices_size + positions_size + bounds_size + indices_size, &staging_offset);
+    }
+
+    if (!staging_data) {
+        offset_allocator_free(&pool->vertex_allocator, vertex_offset, request->vertices_count);
+        offset_allocator_free(&pool->index_allocator, first_index, request->indices_count);
+        return false;
+    }
+
+    // Vertices and indices are packed back to back in the request data. The
+    // position stream and the bounds for GPU culling go between them, where
+    // they stay 4 byte aligned.
+    auto* positions = (glm::vec3*)(staging_data + vertices_size);
+    auto* bounds = (glm::vec4*)(staging_data + vertices_size + positions_size);
+    Uint32 indices_offset = vertices_size + positions_size + bounds_size;
+
+    memcpy(staging_data, vertices, vertices_size);
+
+    for (Uint32 i = 0; i < request->vertices_count; i++) {
+        positions[i] = vertices[i].position;
+    }
+
+    *bounds = glm::vec4(mesh_resource->bounds_center, mesh_resource->bounds_radius);
+
+    memcpy(staging_data + indices_offset, (uint8_t*)request->data + vertices_size, indices_size);
+
+    PendingUpload* vertex_upload = staging_push_upload(renderer);
+    vertex_upload->type = PENDING_UPLOAD_BUFFER;
+    vertex_upload->staging_offset = staging_offset;
+    vertex_upload->size = vertices_size;
+    vertex_upload->buffer = pool->vertex_buffer;
+    vertex_upload->buffer_offset = vertex_offset * (Uint32)sizeof(Vertex);
+
+    PendingUpload* index_upload = staging_push_upload(renderer);
+    index_upload->type = PENDING_UPLOAD_BUFFER;
+    index_upload->staging_offset = staging_offset + indices_offset;
+    index_upload->size = indices_size;
+    index_upload->buffer = pool->index_buffer;
+    index_upload->buffer_offset = first_index * (Uint32)sizeof(uint16_t);
+
+    PendingUpload* position_upload = staging_push_upload(renderer);
+    position_upload->type = PENDING_UPLOAD_BUFFER;
+    position_upload->staging_offset = staging_offset + vertices_size;
+    position_upload->size = positions_size;
+    position_upload->buffer = pool->position_buffer;
+    position_upload->buffer_offset = vertex_offset * (Uint32)sizeof(glm::vec3);
+
+    if (renderer->culling.mesh_bounds_buffer) {
+        PendingUpload* bounds_upload = staging_push_upload(renderer);
+        bounds_upload->type = PENDING_UPLOAD_BUFFER;
+        bounds_upload->staging_offset = staging_offset + vertices_size + positions_size;
+        bounds_upload->size = bounds_size;
+        bounds_upload->buffer = renderer->culling.mesh_bounds_buffer;
+        bounds_upload->buffer_offset = slot_map_index(request->handle) * bounds_size;
+    }
+
+    mesh_resource->handle = MeshHandle(request->handle);
+    mesh_resource->vertex_offset = vertex_offset;
+    mesh_resource->vertices_count = request->vertices_count;
+    mesh_resource->first_index = first_index;
+    mesh_resource->indices_count = request->indices_count;
+
+    SDL_SetAtomicU32(&mesh_resource->ready_batch, renderer->staging.batch);
+
+    return true;
+}
+
+static void reserve_dynamic_mesh(Renderer* renderer, UploadRequest* request)
+{
+    MeshResource* mesh_resource = &renderer->mesh_storage.meshes[slot_map_index(request->handle)];
+    DynamicMesh* dynamic = mesh_dynamic(mesh_resource);
+    DynamicMeshList* list = &renderer->dynamic_meshes;
+
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+
+        auto* handles = (Uint32*)SDL_realloc(list->handles, capacity * sizeof(Uint32));
+        if (!handles) {
+            log_err("Out of memory");
+            return;
+        }
+
+        list->handles = handles;
+        list->capacity = capacity;
+    }
+
+    if (!mesh_pool_alloc(renderer, request->vertices_count * DRAW_DATA_RING_FRAMES, request->indices_count * DRAW_DATA_RING_FRAMES,
+            &dynamic->vertex_base, &dynamic->index_base)) {
+        log_err("Mesh pool full");
+        return;
+    }
+
+    mesh_resource->handle = MeshHandle(request->handle);
+    dynamic->resident = true;
+    list->handles[list->count++] = request->handle;
+}
+
+static SDL_GPUTextureFormat texture_format_to_sdl(TextureFormat format)
+{
+    switch (format) {
+    case TextureFormat::RGBA8:
+        return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    case TextureFormat::BC1:
+        return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+    case TextureFormat::BC3:
+        return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+    }
+
+    return SDL_GPU_TEXTUREFORMAT_INVALID;
+}
+
+static Uint32 full_mip_count(Uint32 width, Uint32 height)
+{
+    Uint32 count = 1;
+    while ((width | height) > 1) {
+        width >>= 1;
+        height >>= 1;
+        count++;
+    }
+
+    return count;
+}
+
+static SDL_GPUTexture* create_array_texture(Renderer* renderer, const TextureArray* array)
+{
+    SDL_GPUTextureCreateInfo texture_create_info = {};
+    texture_create_info.type = SDL_GPU_TEXTURETYPE_2D_ARRAY;
+    texture_create_info.format = texture_format_to_sdl(array->format);
+    texture_create_info.width = array->width;
+    texture_create_info.height = array->height;
+    texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
+    texture_create_info.layer_count_or_depth = array->layer_capacity;
+    texture_create_info.num_levels = array->mip_count;
+    texture_create_info.sample_count = SDL_GPU_SAMPLECOUNT_1;
+
+    // Mip generation blits between levels
+    if (array->generate_mips) {
+        texture_create_info.usage |= SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
+    }
+
+    SDL_GPUTexture* texture = SDL_CreateGPUTexture(renderer->device, &texture_create_info);
+    if (!texture) {
+        log_err("%s", SDL_GetError());
+    }
+
+    return texture;
+}
+
+// Moves the array into a texture with room for layer_capacity layers
+static bool texture_array_grow(Renderer* renderer, TextureArray* array, Uint32 layer_capacity)
+{
+    TextureArray grown = *array;
+    grown.layer_capacity = layer_capacity;
+
+    grown.texture = create_array_texture(renderer, &grown);
+    if (!grown.texture) {
+        return false;
+    }
+
+    // Pending uploads target the old texture, submit them before copying out
+    SDL_GPUCommandBuffer* command_buffer = staging_flush(renderer) ? SDL_AcquireGPUCommandBuffer(renderer->device) : NULL;
+    if (!command_buffer) {
+        log_err("%s", SDL_GetError());
+        SDL_ReleaseGPUTexture(renderer->device, grown.texture);
+        return false;
+    }
+
+    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
+
+    for (Uint32 layer = 0; layer < array->layer_count; layer++) {
+        for (Uint32 level = 0; level < array->mip_count; level++) {
+            SDL_GPUTextureLocation source = {
+                .texture = array->texture,
+                .mip_level = level,
+                .layer = layer,
+            };
+
+            SDL_GPUTextureLocation destination = {
+                .texture = grown.texture,
+                .mip_level = level,
+                .layer = layer,
+            };
+
+            SDL_CopyGPUTextureToTexture(copy_pass, &source, &destination,
+                SDL_max(array->width >> level, 1u), SDL_max(array->height >> level, 1u), 1, false);
+        }
+    }
+
+    SDL_EndGPUCopyPass(copy_pass);
+    SDL_SubmitGPUCommandBuffer(command_buffer);
+
+    // Released once the copies and any frame still sampling it complete
+    SDL_ReleaseGPUTexture(renderer->device, array->texture);
+
+    *array = grown;
+
+    return true;
+}
+
+// Reserves a layer in an array compatible with the given layout, growing the
+// array or opening a new one when every compatible array is full
+static bool texture_array_alloc_layer(Renderer* renderer, TextureFormat format, Uint32 width, Uint32 height,
+    Uint32 mip_count, bool generate_mips, Uint32* out_array_index, Uint32* out_layer)
+{
+    TextureArrayPool* pool = &renderer->texture_arrays;
+
+    for (size_t i = 0; i < pool->count; i++) {
+        TextureArray* array = &pool->arrays[i];
+
+        if (array->format != format || array->width != width || array->height != height
+            || array->mip_count != mip_count || array->generate_mips != generate_mips) {
+            continue;
+        }
+
+        for (Uint32 layer = 0; layer < array->layer_count; layer++) {
+            Uint64 bit = 1ull << (layer % 64);
+
+            if (array->free_layers[layer / 64] & bit) {
+                array->free_layers[layer / 64] &= ~bit;
+
+                *out_array_index = (Uint32)i;
+                *out_layer = layer;
+                return true;
+            }
+        }
+
+        if (array->layer_count == TEXTURE_ARRAY_MAX_LAYERS) {
+            continue;
+        }
+
+        if (array->layer_count == array->layer_capacity
+            && !texture_array_grow(renderer, array, SDL_min(array->layer_capacity * 2, (Uint32)TEXTURE_ARRAY_MAX_LAYERS))) {
+            return false;
+        }
+
+        *out_array_index = (Uint32)i;
+        *out_layer = array->layer_count++;
+        return true;
+    }
+
+    if (pool->count == pool->capacity) {
+        size_t capacity = pool->capacity == 0 ? 16 : pool->capacity * 2;
+
+        auto* arrays = (TextureArray*)SDL_realloc(pool->arrays, capacity * sizeof(TextureArray));
+        if (!arrays) {
+            log_err("Out of memory");
+            return false;
+        }
+
+        pool->arrays = arrays;
+        pool->capacity = capacity;
+    }
+
+    TextureArray array = {
+        .format = format,
+        .width = width,
+        .height = height,
+        .mip_count = mip_count,
+        .generate_mips = generate_mips,
+        .layer_count = 1,
+        .layer_capacity = TEXTURE_ARRAY_INITIAL_LAYERS,
+    };
+
+    array.texture = create_array_texture(renderer, &array);
+    if (!array.texture) {
+        return false;
+    }
+
+    *out_array_index = (Uint32)pool->count;
+    *out_layer = 0;
+    pool->arrays[pool->count++] = array;
+
+    return true;
+}
+
+static void texture_array_free_layer(Renderer* renderer, Uint32 array_index, Uint32 layer)
+{
+    TextureArray* array = &renderer->texture_arrays.arrays[array_index];
+    array->free_layers[layer / 64] |= 1ull << (layer % 64);
+}
+
+// Stages the levels of texture_data into one layer of texture, generate_mips
+// uploads the first level only and fills the rest on the GPU
+static bool upload_texture_layer(Renderer* renderer, SDL_GPUTexture* texture, Uint32 layer,
+    const TextureData* texture_data, Uint32 mip_count, bool generate_mips)
+{
+    Uint32 levels_to_upload = generate_mips ? 1 : mip_count;
+    size_t data_offset = 0;
+
+    for (Uint32 level = 0; level < levels_to_upload; level++) {
+        Uint32 width = SDL_max(texture_data->width >> level, 1u);
+        Uint32 height = SDL_max(texture_data->height >> level, 1u);
+        Uint32 size = (Uint32)texture_level_size(texture_data->format, width, height);
+
+        if (data_offset + size > texture_data->size) {
+            log_err("Texture data is missing mip level %u", level);
+            return false;
+        }
+
+        Uint32 staging_offset;
+        uint8_t* staging_data = staging_alloc(renderer, size, &staging_offset);
+        if (!staging_data) {
+            return false;
+        }
+
+        memcpy(staging_data, texture_data->data + data_offset, size);
+        data_offset += size;
+
+        PendingUpload* upload = staging_push_upload(renderer);
+        upload->type = PENDING_UPLOAD_TEXTURE;
+        upload->staging_offset = staging_offset;
+        upload->size = size;
+        upload->texture = texture;
+        upload->mip_level = level;
+        upload->layer = layer;
+        upload->width = width;
+        upload->height = height;
+        upload->generate_mips = generate_mips;
+    }
+
+    return true;
+}
+
+// A mip_count of 0 in texture_data requests a GPU generated mip chain
+static bool upload_texture(Renderer* renderer, const TextureData* texture_data, TextureResource* texture_resource)
+{
+    bool generate_mips = texture_data->mip_count == 0;
+    Uint32 mip_count = generate_mips ? full_mip_count(texture_data->width, texture_data->height) : texture_data->mip_count;
+    generate_mips = generate_mips && mip_count > 1;
+
+    Uint32 array_index, layer;
+    if (!texture_array_alloc_layer(renderer, texture_data->format, texture_data->width, texture_data->height,
+            mip_count, generate_mips, &array_index, &layer)) {
+        return false;
+    }
+
+    SDL_GPUTexture* texture = renderer->texture_arrays.arrays[array_index].texture;
+
+    // No frame has sampled the layer yet, and copies of a later texture into it
+    // are submitted after any left pending from this one
+    if (!upload_texture_layer(renderer, texture, layer, texture_data, mip_count, generate_mips)) {
+        texture_array_free_layer(renderer, array_index, layer);
+        return false;
+    }
+
+    texture_resource->array_index = array_index;
+    texture_resource->layer = layer;
+
+    return true;
+}
+
+static void defer_release(Renderer* renderer, const DeferredRelease* release)
+{
+    DeferredReleaseQueue* queue = &renderer->deferred_releases;
+
+    if (queue->count == queue->capacity) {
+        size_t capacity = queue->capacity == 0 ? 64 : queue->capacity * 2;
+
+        auto* releases = (DeferredRelease*)SDL_realloc(queue->releases, capacity * sizeof(DeferredRelease));
+        if (!releases) {
+            log_err("Out of memory, leaking destroyed resource");
+            return;
+        }
+
+        queue->releases = releases;
+        queue->capacity = capacity;
+    }
+
+    queue->releases[queue->count] = *release;
+    queue->releases[queue->count].frame = renderer->frame_index;
+    queue->count++;
+}
+
+// Frees what was destroyed more than frames_in_flight frames ago, no frame
+// still executing on the GPU can reference it anymore
+static void process_deferred_releases(Renderer* renderer)
+{
+    DeferredReleaseQueue* queue = &renderer->deferred_releases;
+
+    for (size_t i = 0; i < queue->count;) {
+        DeferredRelease* release = &queue->releases[i];
+
+        if (renderer->frame_index <= release->frame + renderer->frames_in_flight) {
+            i++;
+            continue;
+        }
+
+        switch (release->type) {
+        case DEFERRED_RELEASE_MESH: {
+            offset_allocator_free(&renderer->mesh_pool.vertex_allocator, release->as.mesh.vertex_offset, release->as.mesh.vertices_count);
+            offset_allocator_free(&renderer->mesh_pool.index_allocator, release->as.mesh.first_index, release->as.mesh.indices_count);
+        } break;
+        case DEFERRED_RELEASE_TEXTURE: {
+            texture_array_free_layer(renderer, release->as.texture.array_index, release->as.texture.layer);
+        } break;
+        }
+
+        *release = queue->releases[--queue->count];
+    }
+}
+
+static void destroy_mesh(Renderer* renderer, Uint32 handle)
+{
+    MeshResource* mesh_resource = &renderer->mesh_storage.meshes[slot_map_index(handle)];
+    DynamicMesh* dynamic = mesh_dynamic(mesh_resource);
+
+    // Meshes whose upload failed own no pool ranges
+    if (dynamic) {
+        if (dynamic->resident) {
+            DeferredRelease release = {};
+            release.type = DEFERRED_RELEASE_MESH;
+            release.as.mesh.vertex_offset = dynamic->vertex_base;
+            release.as.mesh.vertices_count = dynamic->max_vertices * DRAW_DATA_RING_FRAMES;
+            release.as.mesh.first_index = dynamic->index_base;
+            release.as.mesh.indices_count = dynamic->max_indices * DRAW_DATA_RING_FRAMES;
+            defer_release(renderer, &release);
+
+            DynamicMeshList* list = &renderer->dynamic_meshes;
+            for (size_t i = 0; i < list->count; i++) {
+                if (list->handles[i] == handle) {
+                    list->handles[i] = list->handles[--list->count];
+                    break;
+                }
+            }
+        }
+
+        SDL_free(dynamic->buffers);
+        SDL_free(dynamic);
+        mesh_set_dynamic(mesh_resource, NULL);
+    } else if (mesh_resource->indices_count != 0) {
+        DeferredRelease release = {};
+        release.type = DEFERRED_RELEASE_MESH;
+        release.as.mesh.vertex_offset = mesh_resource->vertex_offset;
+        release.as.mesh.vertices_count = mesh_resource->vertices_count;
+        release.as.mesh.first_index = mesh_resource->first_index;
+        release.as.mesh.indices_count = mesh_resource->indices_count;
+        defer_release(renderer, &release);
+    }
+
+    mesh_resource->indices_count = 0;
+    SDL_SetAtomicU32(&mesh_resource->ready_batch, 0);
+
+    slot_map_release(&renderer->mesh_storage.slots, handle);
+}
+
+// A handle whose upload failed would otherwise stay live and never become
+// ready. It is made stale like a destroyed one, unless the game destroyed it
+// already and the queued destroy releases it.
+static void fail_mesh_upload(Renderer* renderer, Uint32 handle)
+{
+    log_err("Could not upload mesh %u, the handle is now stale", handle);
+
+    if (slot_map_retire(&renderer->mesh_storage.slots, handle)) {
+        destroy_mesh(renderer, handle);
+    }
+}
+
+static void destroy_texture(Renderer* renderer, Uint32 handle)
+{
+    TextureResource* texture_resource = &renderer->texture_storage.textures[slot_map_index(handle)];
+
+    if (SDL_GetAtomicU32(&texture_resource->ready_batch) != 0) {
+        DeferredRelease release = {};
+        release.type = DEFERRED_RELEASE_TEXTURE;
+        release.as.texture.array_index = texture_resource->array_index;
+        release.as.texture.layer = texture_resource->layer;
+        defer_release(renderer, &release);
+    }
+
+    SDL_SetAtomicU32(&texture_resource->ready_batch, 0);
+
+    slot_map_release(&renderer->texture_storage.slots, handle);
+}
+
+// Same as fail_mesh_upload, the failed upload already gave its layer back
+static void fail_texture_upload(Renderer* renderer, Uint32 handle)
+{
+    log_err("Could not upload texture %u, the handle is now stale", handle);
+
+    if (slot_map_retire(&renderer->texture_storage.slots, handle)) {
+        destroy_texture(renderer, handle);
+    }
+}
+
+static bool upload_material_data(Renderer* renderer, Uint32 index, const MaterialData* material_data)
+{
+    Uint32 staging_offset;
+    uint8_t* staging_data = staging_alloc(renderer, sizeof(MaterialData), &staging_offset);
+    if (!staging_data) {
+        return false;
+    }
+
+    memcpy(staging_data, material_data, sizeof(MaterialData));
+
+    PendingUpload* upload = staging_push_upload(renderer);
+    upload->type = PENDING_UPLOAD_BUFFER;
+    upload->staging_offset = staging_offset;
+    upload->size = sizeof(MaterialData);
+    upload->buffer = renderer->material_buffer;
+    upload->buffer_offset = index * (Uint32)sizeof(MaterialData);
+
+    return true;
+}
+
+// The albedo was queued before the material, so its layer is known by now
+static void upload_material(Renderer* renderer, UploadRequest* request)
+{
+    MaterialResource* material_resource = &renderer->material_storage.materials[slot_map_index(request->handle)];
+
+    MaterialData material_data = {};
+
+    if (slot_map_is_live(&renderer->texture_storage.slots, request->albedo)) {
+        material_data.texture_layer = renderer->texture_storage.textures[slot_map_index(request->albedo)].layer;
+    }
+
+    material_data.flags = (Uint32)request->material_flags;
+
+    if (request->material_flags & MATERIAL_FLAG_ALPHA_TEST) {
+        material_data.alpha_cutoff = 0.5f;
+    }
+
+    if (!upload_material_data(renderer, slot_map_index(request->handle) + 1, &material_data)) {
+        return;
+    }
+
+    material_resource->handle = MaterialHandle(request->handle);
+    material_resource->albedo = TextureHandle(request->albedo);
+    material_resource->pipeline = (request->material_flags & MATERIAL_FLAG_ALPHA_TEST) ? MATERIAL_PIPELINE_ALPHA_TEST : MATERIAL_PIPELINE_OPAQUE;
+
+    SDL_SetAtomicU32(&material_resource->ready_batch, renderer->staging.batch);
+}
+
+// Drains the upload queue into the staging ring and submits everything that
+// was queued since the last frame as a single copy pass.
+static void renderer_process_uploads(Renderer* renderer)
+{
+    staging_poll(renderer);
+    process_deferred_releases(renderer);
+
+    UploadRequest request;
+    while (upload_queue_pop(&renderer->upload_queue, &request)) {
+        switch (request.type) {
+        case UPLOAD_REQUEST_MESH: {
+            if (!upload_mesh(renderer, &request)) {
+                fail_mesh_upload(renderer, request.handle);
+            }
+        } break;
+        case UPLOAD_REQUEST_DYNAMIC_MESH: {
+            reserve_dynamic_mesh(renderer, &request);
+        } break;
+        case UPLOAD_REQUEST_TEXTURE: {
+            TextureResource* texture_resource = &renderer->texture_storage.textures[slot_map_index(request.handle)];
+
+            texture_resource->handle = TextureHandle(request.handle);
+            TextureData texture_data = {
+                .format = request.format,
+                .width = request.width,
+                .height = request.height,
+                .mip_count = request.mip_count,
+                .data = (const uint8_t*)request.data,
+                .size = request.data_size,
+            };
+
+            if (upload_texture(renderer, &texture_data, texture_resource)) {
+                SDL_SetAtomicU32(&texture_resource->ready_batch, renderer->staging.batch);
+            } else {
+                fail_texture_upload(renderer, request.handle);
+            }
+        } break;
+        case UPLOAD_REQUEST_MATERIAL: {
+            upload_material(renderer, &request);
+        } break;
+        case UPLOAD_REQUEST_DESTROY_MESH: {
+            destroy_mesh(renderer, request.handle);
+        } break;
+        case UPLOAD_REQUEST_DESTROY_TEXTURE: {
+            destroy_texture(renderer, request.handle);
+        } break;
+        }
+
+        SDL_free(request.data);
+    }
+
+    staging_flush(renderer);
+}
+
+static SDL_GPUTexture* create_target_texture(Renderer* renderer, SDL_GPUTextureFormat format, SDL_GPUTextureUsageFlags usage,
+    Uint32 width, Uint32 height, SDL_GPUSampleCount sample_count)
+{
+    SDL_GPUTextureCreateInfo texture_create_info = {
+        .type = SDL_GPU_TEXTURETYPE_2D,
+        .format = format,
+        .usage = usage,
+        .width = width,
+        .height = height,
+        .layer_count_or_depth = 1,
+        .num_levels = 1,
+        .sample_count = sample_count,
+    };
+
+    SDL_GPUTexture* texture = SDL_CreateGPUTexture(renderer->device, &texture_create_info);
+    if (!texture) {
+        log_err("%s", SDL_GetError());
+    }
+
+    return texture;
+}
+
+// (Re)creates the scene targets and pipeline when the swapchain size or the
+// requested sample count changed since the last frame
+static bool scene_targets_ensure(Renderer* renderer, Uint32 width, Uint32 height)
+{
+    SDL_GPUSampleCount sample_count = renderer->requested_sample_count;
+
+    if (renderer->scene_texture && renderer->target_width == width && renderer->target_height == height
+        && renderer->sample_count == sample_count) {
+        return true;
+    }
+
+    SDL_GPUTextureFormat color_format = SDL_GetGPUSwapchainTextureFormat(renderer->device, renderer->window);
+
+    if (!SDL_GPUTextureSupportsSampleCount(renderer->device, color_format, sample_count)
+        || !SDL_GPUTextureSupportsSampleCount(renderer->device, SDL_GPU_TEXTUREFORMAT_D32_FLOAT, sample_count)) {
+        log_warn("%ux MSAA is not supported, disabling it", 1u << sample_count);
+        sample_count = SDL_GPU_SAMPLECOUNT_1;
+        renderer->requested_sample_count = sample_count;
+    }
+
+    PipelineDesc scene_desc = {
+        .vertex_shader = "vert.spv",
+        .fragment_shader = "frag.spv",
+        .vertex_uniform_buffers = 1,
+        .vertex_storage_buffers = 2,
+        .fragment_samplers = 1,
+        .primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST,
+        .fill_mode = SDL_GPU_FILLMODE_FILL,
+        .depth_compare_op = SDL_GPU_COMPAREOP_LESS,
+        .depth_write = true,
+        .color_format = color_format,
+        .sample_count = sample_count,
+    };
+
+    // Previously built sample counts stay in the registry, switching back is free
+    PipelineId scene_pipeline = pipeline_registry_find_or_create(&renderer->pipelines, &scene_desc);
+    if (!scene_pipeline) {
+        return false;
+    }
+
+    renderer->scene_pipeline = scene_pipeline;
+
+#ifdef ALMOND_DEBUG_DRAW
+    // Lines over the scene, tested against its depth without writing it
+    PipelineDesc debug_lines_desc = {
+        .vertex_shader = "debug_vert.spv",
+        .fragment_shader = "debug_frag.spv",
+        .vertex_uniform_buffers = 1,
+        .vertex_layout = PIPELINE_VERTEX_LAYOUT_DEBUG,
+        .primitive_type = SDL_GPU_PRIMITIVETYPE_LINELIST,
+        .fill_mode = SDL_GPU_FILLMODE_FILL,
+        .depth_compare_op = SDL_GPU_COMPAREOP_LESS_OR_EQUAL,
+        .depth_write = false,
+        .color_format = color_format,
+        .sample_count = sample_count,
+    };
+
+    renderer->debug_lines_pipeline = pipeline_registry_find_or_create(&renderer->pipelines, &debug_lines_desc);
+#endif
+
+    // The pre-pass reads the position stream and writes depth only, the color
+    // pass then shades just the samples that survive it
+    PipelineDesc depth_prepass_desc = scene_desc;
+    depth_prepass_desc.vertex_shader = "depth_vert.spv";
+    depth_prepass_desc.fragment_shader = "depth_frag.spv";
+    depth_prepass_desc.vertex_storage_buffers = 1;
+    depth_prepass_desc.fragment_samplers = 0;
+    depth_prepass_desc.vertex_layout = PIPELINE_VERTEX_LAYOUT_POSITION;
+    depth_prepass_desc.color_mode = PIPELINE_COLOR_NONE;
+
+    // Alpha tested materials are never in the pre-pass, they always test LESS
+    PipelineDesc alpha_test_desc = scene_desc;
+    alpha_test_desc.fragment_shader = "alpha_test_frag.spv";
+
+    PipelineDesc scene_equal_desc = scene_desc;
+    scene_equal_desc.depth_compare_op = SDL_GPU_COMPAREOP_EQUAL;
+    scene_equal_desc.depth_write = false;
+
+    PipelineDesc overdraw_desc = depth_prepass_desc;
+    overdraw_desc.fragment_shader = "overdraw_frag.spv";
+    overdraw_desc.color_mode = PIPELINE_COLOR_ADDITIVE;
+
+    PipelineDesc overdraw_equal_desc = overdraw_desc;
+    overdraw_equal_desc.depth_compare_op = SDL_GPU_COMPAREOP_EQUAL;
+    overdraw_equal_desc.depth_write = false;
+
+    renderer->alpha_test_pipeline = pipeline_registry_find_or_create(&renderer->pipelines, &alpha_test_desc);
+    renderer->depth_prepass_pipeline = pipeline_registry_find_or_create(&renderer->pipelines, &depth_prepass_desc);
+    renderer->scene_equal_pipeline = pipeline_registry_find_or_create(&renderer->pipelines, &scene_equal_desc);
+    renderer->overdraw_pipeline = pipeline_registry_find_or_create(&renderer->pipelines, &overdraw_desc);
+    renderer->overdraw_equal_pipeline = pipeline_registry_find_or_create(&renderer->pipelines, &overdraw_equal_desc);
+
+    // Released textures stay alive until the frames using them complete
+    SDL_ReleaseGPUTexture(renderer->device, renderer->depth_texture);
+    SDL_ReleaseGPUTexture(renderer->device, renderer->msaa_texture);
+    SDL_ReleaseGPUTexture(renderer->device, renderer->scene_texture);
+    renderer->msaa_texture = NULL;
+
+    renderer->depth_texture = create_target_texture(renderer, SDL_GPU_TEXTUREFORMAT_D32_FLOAT,
+        SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET, width, height, sample_count);
+
+    if (sample_count != SDL_GPU_SAMPLECOUNT_1) {
+        renderer->msaa_texture = create_target_texture(renderer, color_format,
+            SDL_GPU_TEXTUREUSAGE_COLOR_TARGET, width, height, sample_count);
+    }
+
+    renderer->scene_texture = create_target_texture(renderer, color_format,
+        SDL_GPU_TEXTUREUSAGE_COLOR_TARGET | SDL_GPU_TEXTUREUSAGE_SAMPLER, width, height, SDL_GPU_SAMPLECOUNT_1);
+
+    renderer->target_width = width;
+    renderer->target_height = height;
+    renderer->sample_count = sample_count;
+
+    renderer->projection_matrix = glm::perspective(glm::radians(45.0f), (float)width / (float)height, RENDERER_NEAR_PLANE, RENDERER_FAR_PLANE);
+
+    return renderer->depth_texture && renderer->scene_texture && (sample_count == SDL_GPU_SAMPLECOUNT_1 || renderer->msaa_texture);
+}
+
+#define CULL_THREADCOUNT 64
+
+// Laid out to match the std140 block in cull_comp.glsl
+typedef struct {
+    glm::vec4 planes[6];
+    Uint32 first_draw;
+    Uint32 draw_count;
+    Uint32 padding[2];
+} CullUniforms;
+
+// Draws are submitted unculled when this fails
+static void gpu_culling_init(Renderer* renderer)
+{
+    GpuCulling* culling = &renderer->culling;
+
+    ComputePipelineDesc desc = {
+        .shader = "cull_comp.spv",
+        .readonly_storage_buffers = 2,
+        .readwrite_storage_buffers = 2,
+        .uniform_buffers = 1,
+        .threadcount_x = CULL_THREADCOUNT,
+    };
+
+    culling->pipeline = pipeline_registry_create_compute(&renderer->pipelines, &desc);
+    if (!culling->pipeline) {
+        log_warn("GPU culling is unavailable");
+        return;
+    }
+
+    SDL_GPUBufferCreateInfo bounds_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+        .size = MESH_STORAGE_CAPACITY * (Uint32)sizeof(glm::vec4),
+    };
+
+    culling->mesh_bounds_buffer = SDL_CreateGPUBuffer(renderer->device, &bounds_create_info);
+    if (!culling->mesh_bounds_buffer) {
+        log_err("%s", SDL_GetError());
+        SDL_ReleaseGPUComputePipeline(renderer->device, culling->pipeline);
+        culling->pipeline = NULL;
+    }
+}
+
+// Grows the per-frame culling buffers to hold count draws and as many batches
+static bool gpu_culling_reserve(Renderer* renderer, Uint32 count)
+{
+    GpuCulling* culling = &renderer->culling;
+
+    if (culling->culled_buffer && count <= culling->capacity) {
+        return true;
+    }
+
+    Uint32 capacity = culling->capacity == 0 ? 1024 : culling->capacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    // Frames still in flight keep the old buffers alive until they complete
+    SDL_ReleaseGPUBuffer(renderer->device, culling->culled_buffer);
+    SDL_ReleaseGPUBuffer(renderer->device, culling->indirect_buffer);
+    SDL_ReleaseGPUTransferBuffer(renderer->device, culling->indirect_transfer_buffer);
+    culling->capacity = 0;
+
+    SDL_GPUBufferCreateInfo culled_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE | SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
+        .size = capacity * (Uint32)sizeof(DrawData),
+    };
+
+    SDL_GPUBufferCreateInfo indirect_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE | SDL_GPU_BUFFERUSAGE_INDIRECT,
+        .size = capacity * (Uint32)sizeof(SDL_GPUIndexedIndirectDrawCommand),
+    };
+
+    SDL_GPUTransferBufferCreateInfo transfer_create_info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = capacity * (Uint32)sizeof(SDL_GPUIndexedIndirectDrawCommand),
+    };
+
+    culling->culled_buffer = SDL_CreateGPUBuffer(renderer->device, &culled_create_info);
+    culling->indirect_buffer = SDL_CreateGPUBuffer(renderer->device, &indirect_create_info);
+    culling->indirect_transfer_buffer = SDL_CreateGPUTransferBuffer(renderer->device, &transfer_create_info);
+
+    if (!culling->culled_buffer || !culling->indirect_buffer || !culling->indirect_transfer_buffer) {
+        log_err("%s", SDL_GetError());
+        SDL_ReleaseGPUBuffer(renderer->device, culling->culled_buffer);
+        SDL_ReleaseGPUBuffer(renderer->device, culling->indirect_buffer);
+        SDL_ReleaseGPUTransferBuffer(renderer->device, culling->indirect_transfer_buffer);
+        culling->culled_buffer = NULL;
+        culling->indirect_buffer = NULL;
+        culling->indirect_transfer_buffer = NULL;
+        return false;
+    }
+
+    culling->capacity = capacity;
+
+    return true;
+}
+
+// Gribb-Hartmann extraction, normalized so distances are in world units
+static void frustum_planes_from_matrix(const glm::mat4& m, glm::vec4 planes[6])
+{
+    glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+
+    for (int i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+// Uploads one indirect command per batch with no instances, for the cull
+// pass to fill in. first_instance is relative to culled_buffer.
+static void gpu_culling_upload_commands(Renderer* renderer, SDL_GPUCopyPass* copy_pass, Uint32 first_draw)
+{
+    GpuCulling* culling = &renderer->culling;
+    DrawBatchList* batches = &renderer->draw_batches;
+
+    auto* commands = (SDL_GPUIndexedIndirectDrawCommand*)SDL_MapGPUTransferBuffer(renderer->device, culling->indirect_transfer_buffer, true);
+    if (!commands) {
+        log_err("%s", SDL_GetError());
+        return;
+    }
+
+    for (size_t i = 0; i < batches->count; i++) {
+        DrawBatch* batch = &batches->batches[i];
+
+        commands[i] = {
+            .num_indices = batch->mesh->indices_count,
+            .num_instances = 0,
+            .first_index = batch->mesh->first_index,
+            .vertex_offset = (Sint32)batch->mesh->vertex_offset,
+            .first_instance = batch->first_instance - first_draw,
+        };
+    }
+
+    SDL_UnmapGPUTransferBuffer(renderer->device, culling->indirect_transfer_buffer);
+
+    SDL_GPUTransferBufferLocation location = {
+        .transfer_buffer = culling->indirect_transfer_buffer,
+        .offset = 0,
+    };
+
+    SDL_GPUBufferRegion region = {
+        .buffer = culling->indirect_buffer,
+        .offset = 0,
+        .size = (Uint32)(batches->count * sizeof(SDL_GPUIndexedIndirectDrawCommand)),
+    };
+
+    // The previous frame may still draw from the buffer
+    SDL_UploadToGPUBuffer(copy_pass, &location, &region, true);
+
+    renderer->stats.upload_bytes += region.size;
+}
+
+static void gpu_culling_dispatch(Renderer* renderer, SDL_GPUCommandBuffer* command_buffer,
+    const glm::mat4& proj_view, Uint32 first_draw, Uint32 draw_count)
+{
+    GpuCulling* culling = &renderer->culling;
+
+    CullUniforms uniforms = {};
+    frustum_planes_from_matrix(proj_view, uniforms.planes);
+    uniforms.first_draw = first_draw;
+    uniforms.draw_count = draw_count;
+
+    // The indirect commands keep the contents uploaded above, the culled
+    // draws are rewritten and can take a fresh buffer
+    SDL_GPUStorageBufferReadWriteBinding storage_bindings[2] = {
+        { .buffer = culling->culled_buffer, .cycle = true },
+        { .buffer = culling->indirect_buffer, .cycle = false },
+    };
+
+    SDL_GPUComputePass* compute_pass = SDL_BeginGPUComputePass(command_buffer, NULL, 0, storage_bindings, 2);
+
+    SDL_GPUBuffer* readonly_buffers[2] = { renderer->draw_data.buffer, culling->mesh_bounds_buffer };
+
+    SDL_BindGPUComputePipeline(compute_pass, culling->pipeline);
+    SDL_BindGPUComputeStorageBuffers(compute_pass, 0, readonly_buffers, 2);
+    SDL_PushGPUComputeUniformData(command_buffer, 0, &uniforms, sizeof(uniforms));
+    SDL_DispatchGPUCompute(compute_pass, (draw_count + CULL_THREADCOUNT - 1) / CULL_THREADCOUNT, 1, 1);
+
+    SDL_EndGPUComputePass(compute_pass);
+}
+
+static const char* present_mode_name(SDL_GPUPresentMode present_mode)
+{
+    switch (present_mode) {
+    case SDL_GPU_PRESENTMODE_VSYNC:
+        return "vsync";
+    case SDL_GPU_PRESENTMODE_MAILBOX:
+        return "mailbox";
+    case SDL_GPU_PRESENTMODE_IMMEDIATE:
+        return "immediate";
+    }
+
+    return "unknown";
+}
+
+// Immediate falls back to mailbox, which keeps latency low without tearing,
+// and mailbox falls back to vsync
+static SDL_GPUPresentMode choose_present_mode(Renderer* renderer, SDL_GPUPresentMode requested)
+{
+    SDL_GPUPresentMode present_mode = requested;
+
+    if (present_mode == SDL_GPU_PRESENTMODE_IMMEDIATE
+        && !SDL_WindowSupportsGPUPresentMode(renderer->device, renderer->window, present_mode)) {
+        present_mode = SDL_GPU_PRESENTMODE_MAILBOX;
+    }
+
+    if (present_mode == SDL_GPU_PRESENTMODE_MAILBOX
+        && !SDL_WindowSupportsGPUPresentMode(renderer->device, renderer->window, present_mode)) {
+        present_mode = SDL_GPU_PRESENTMODE_VSYNC;
+    }
+
+    if (present_mode != requested) {
+        log_warn("Present mode %s is not supported, using %s", present_mode_name(requested), present_mode_name(present_mode));
+    }
+
+    return present_mode;
+}
+
+bool renderer_init(Renderer* renderer, SDL_Window* window, const RendererConfig* config)
+{
+    renderer->window = window;
+
+    renderer->device = SDL_CreateGPUDevice(SDL_GPU_SHADERFORMAT_SPIRV, true, "vulkan");
+
+    if (!SDL_ClaimWindowForGPUDevice(renderer->device, renderer->window)) {
+        log_err("%s", SDL_GetError());
+    }
+
+    renderer->present_mode = choose_present_mode(renderer, config->present_mode);
+
+    if (!SDL_SetGPUSwapchainParameters(renderer->device, renderer->window, SDL_GPU_SWAPCHAINCOMPOSITION_SDR, renderer->present_mode)) {
+        log_err("%s", SDL_GetError());
+    }
+
+    renderer->frames_in_flight = SDL_clamp(config->frames_in_flight, 1u, (Uint32)RENDERER_MAX_FRAMES_IN_FLIGHT);
+
+    if (!SDL_SetGPUAllowedFramesInFlight(renderer->device, renderer->frames_in_flight)) {
+        log_err("%s", SDL_GetError());
+    }
+
+    if (!pipeline_registry_init(&renderer->pipelines, renderer->device, "shaders")) {
+        return false;
+    }
+
+    renderer->requested_sample_count = config->sample_count;
+    resolution_scaler_init(&renderer->resolution_scaler, config->frame_budget_ms);
+
+    renderer->stats_report.enabled = config->log_stats;
+    renderer->depth_prepass = config->depth_prepass;
+    renderer->stats_report.start = SDL_GetPerformanceCounter();
+
+    int width, height;
+    SDL_GetWindowSizeInPixels(window, &width, &height);
+
+    if (!scene_targets_ensure(renderer, (Uint32)width, (Uint32)height)) {
+        return false;
+    }
+
+    // Texels stay crisp up close, minified textures are filtered across mips
+    SDL_GPUSamplerCreateInfo sampler_info = {
+        .min_filter = SDL_GPU_FILTER_LINEAR,
+        .mag_filter = SDL_GPU_FILTER_NEAREST,
+        .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_LINEAR,
+        .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_REPEAT,
+        .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_REPEAT,
+        .address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_REPEAT,
+        .min_lod = 0.0f,
+        .max_lod = 1000.0f,
+    };
+
+    renderer->texture_sampler = SDL_CreateGPUSampler(renderer->device, &sampler_info);
+
+    if (!staging_init(renderer)) {
+        return false;
+    }
+
+    if (!mesh_pool_init(renderer)) {
+        return false;
+    }
+
+    gpu_culling_init(renderer);
+    renderer->gpu_culling = config->gpu_culling;
+
+    renderer->mesh_storage.meshes = (MeshResource*)SDL_calloc(MESH_STORAGE_CAPACITY, sizeof(MeshResource));
+    renderer->texture_storage.textures = (TextureResource*)SDL_calloc(TEXTURE_STORAGE_CAPACITY, sizeof(TextureResource));
+    renderer->material_storage.materials = (MaterialResource*)SDL_calloc(MATERIAL_STORAGE_CAPACITY, sizeof(MaterialResource));
+
+    if (!renderer->mesh_storage.meshes || !renderer->texture_storage.textures || !renderer->material_storage.materials
+        || !slot_map_init(&renderer->mesh_storage.slots, MESH_STORAGE_CAPACITY)
+        || !slot_map_init(&renderer->texture_storage.slots, TEXTURE_STORAGE_CAPACITY)
+        || !slot_map_init(&renderer->material_storage.slots, MATERIAL_STORAGE_CAPACITY)) {
+        log_err("Could not create resource storage");
+        return false;
+    }
+
+    SDL_GPUBufferCreateInfo material_buffer_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ,
+        .size = (MATERIAL_STORAGE_CAPACITY + 1) * (Uint32)sizeof(MaterialData),
+    };
+
+    renderer->material_buffer = SDL_CreateGPUBuffer(renderer->device, &material_buffer_create_info);
+    if (!renderer->material_buffer) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    if (!upload_queue_init(&renderer->upload_queue, 4096)) {
+        log_err("Could not create upload queue");
+        return false;
+    }
+
+    // Bound in place of textures that are still being uploaded
+    const uint8_t fallback_pixel[4] = { 255, 255, 255, 255 };
+
+    TextureData fallback_data = {
+        .format = TextureFormat::RGBA8,
+        .width = 1,
+        .height = 1,
+        .mip_count = 1,
+        .data = fallback_pixel,
+        .size = sizeof(fallback_pixel),
+    };
+
+    TextureArray fallback_array = {
+        .format = TextureFormat::RGBA8,
+        .width = 1,
+        .height = 1,
+        .mip_count = 1,
+        .generate_mips = false,
+        .layer_count = 1,
+        .layer_capacity = 1,
+    };
+
+    renderer->fallback_texture = create_array_texture(renderer, &fallback_array);
+    if (!renderer->fallback_texture || !upload_texture_layer(renderer, renderer->fallback_texture, 0, &fallback_data, 1, false)) {
+        return false;
+    }
+
+    // Drawn with the fallback texture whenever a draw has no ready material
+    MaterialData default_material = {};
+    if (!upload_material_data(renderer, 0, &default_material)) {
+        return false;
+    }
+
+    return staging_flush(renderer);
+}
+
+void renderer_shutdown(Renderer* renderer)
+{
+    SDL_WaitForGPUIdle(renderer->device);
+
+    // The rebuild worker must not touch the device once it is gone
+    pipeline_registry_shutdown(&renderer->pipelines);
+
+    SDL_ReleaseWindowFromGPUDevice(renderer->device, renderer->window);
+    SDL_DestroyGPUDevice(renderer->device);
+    renderer->device = NULL;
+}
+
+MeshHandle renderer_create_mesh(Renderer* renderer, MeshData* mesh_data)
+{
+    if (mesh_data->indices_count == 0 || mesh_data->vertices_count == 0) {
+        log_err("Empty mesh");
+        return MeshHandle::invalid();
+    }
+
+    size_t vertices_size = mesh_data->vertices_count * sizeof(*mesh_data->vertices);
+    size_t indices_size = mesh_data->indices_count * sizeof(*mesh_data->indices);
+
+    Uint32 handle = slot_map_alloc(&renderer->mesh_storage.slots);
+    if (!handle) {
+        log_err("Mesh storage full");
+        return MeshHandle::invalid();
+    }
+
+    // The caller's data usually lives in a transient arena, keep a copy until upload
+    UploadRequest request = {};
+    request.type = UPLOAD_REQUEST_MESH;
+    request.handle = handle;
+    request.vertices_count = (Uint32)mesh_data->vertices_count;
+    request.indices_count = (Uint32)mesh_data->indices_count;
+    request.data = SDL_malloc(vertices_size + indices_size);
+
+    if (!request.data) {
+        log_err("Out of memory");
+        slot_map_retire(&renderer->mesh_storage.slots, handle);
+        slot_map_release(&renderer->mesh_storage.slots, handle);
+        return MeshHandle::invalid();
+    }
+
+    memcpy(request.data, mesh_data->vertices, vertices_size);
+    memcpy((uint8_t*)request.data + vertices_size, mesh_data->indices, indices_size);
+
+    if (!upload_queue_push(&renderer->upload_queue, &request)) {
+        log_err("Out of memory");
+        SDL_free(request.data);
+        slot_map_retire(&renderer->mesh_storage.slots, handle);
+        slot_map_release(&renderer->mesh_storage.slots, handle);
+        return MeshHandle::invalid();
+    }
+
+    return MeshHandle(request.handle);
+}
+
+void renderer_create_meshes(Renderer* renderer, MeshData* mesh_datas, size_t count, MeshHandle* out_handles)
+{
+    for (size_t i = 0; i < count; i++) {
+        out_handles[i] = renderer_create_mesh(renderer, &mesh_datas[i]);
+    }
+}
+
+static TextureHandle queue_texture(Renderer* renderer, const TextureData* texture_data)
+{
+    Uint32 handle = slot_map_alloc(&renderer->texture_storage.slots);
+    if (!handle) {
+        log_err("Texture storage full");
+        return TextureHandle::invalid();
+    }
+
+    UploadRequest request = {};
+    request.type = UPLOAD_REQUEST_TEXTURE;
+    request.handle = handle;
+    request.format = texture_data->format;
+    request.width = texture_data->width;
+    request.height = texture_data->height;
+    request.mip_count = texture_data->mip_count;
+    request.data_size = texture_data->size;
+    request.data = SDL_malloc(texture_data->size);
+
+    if (!request.data) {
+        log_err("Out of memory");
+        slot_map_retire(&renderer->texture_storage.slots, handle);
+        slot_map_release(&renderer->texture_storage.slots, handle);
+        return TextureHandle::invalid();
+    }
+
+    memcpy(request.data, texture_data->data, texture_data->size);
+
+    if (!upload_queue_push(&renderer->upload_queue, &request)) {
+        log_err("Out of memory");
+        SDL_free(request.data);
+        slot_map_retire(&renderer->texture_storage.slots, handle);
+        slot_map_release(&renderer->texture_storage.slots, handle);
+        return TextureHandle::invalid();
+    }
+
+    return TextureHandle(request.handle);
+}
+
+TextureHandle renderer_create_texture(Renderer* renderer, const uint8_t* rgba_data, uint32_t width, uint32_t height)
+{
+    TextureData texture_data = {
+        .format = TextureFormat::RGBA8,
+        .width = width,
+        .height = height,
+        .mip_count = 0,
+        .data = rgba_data,
+        .size = texture_level_size(TextureFormat::RGBA8, width, height),
+    };
+
+    return queue_texture(renderer, &texture_data);
+}
+
+TextureHandle renderer_create_texture_from_data(Renderer* renderer, const TextureData* texture_data)
+{
+    if (texture_data->mip_count == 0 || texture_data->width == 0 || texture_data->height == 0) {
+        log_err("Empty texture");
+        return TextureHandle::invalid();
+    }
+
+    if (!renderer_is_texture_format_supported(renderer, texture_data->format)) {
+        log_err("Texture format is not supported");
+        return TextureHandle::invalid();
+    }
+
+    return queue_texture(renderer, texture_data);
+}
+
+bool renderer_is_texture_format_supported(Renderer* renderer, TextureFormat format)
+{
+    return SDL_GPUTextureSupportsFormat(renderer->device, texture_format_to_sdl(format), SDL_GPU_TEXTURETYPE_2D, SDL_GPU_TEXTUREUSAGE_SAMPLER);
+}
+
+void renderer_destroy_mesh(Renderer* renderer, MeshHandle handle)
+{
+    if (!slot_map_retire(&renderer->mesh_storage.slots, handle.value)) {
+        log_warn("Destroying a stale mesh handle");
+        return;
+    }
+
+    UploadRequest request = {};
+    request.type = UPLOAD_REQUEST_DESTROY_MESH;
+    request.handle = handle.value;
+
+    if (!upload_queue_push(&renderer->upload_queue, &request)) {
+        log_err("Out of memory, leaking mesh");
+    }
+}
+
+void renderer_destroy_texture(Renderer* renderer, TextureHandle handle)
+{
+    if (!slot_map_retire(&renderer->texture_storage.slots, handle.value)) {
+        log_warn("Destroying a stale texture handle");
+        return;
+    }
+
+    UploadRequest request = {};
+    request.type = UPLOAD_REQUEST_DESTROY_TEXTURE;
+    request.handle = handle.value;
+
+    if (!upload_queue_push(&renderer->upload_queue, &request)) {
+        log_err("Out of memory, leaking texture");
+    }
+}
+
+bool renderer_is_mesh_ready(Renderer* renderer, MeshHandle handle)
+{
+    if (!slot_map_is_live(&renderer->mesh_storage.slots, handle.value)) {
+        return false;
+    }
+
+    MeshResource* mesh_resource = &renderer->mesh_storage.meshes[slot_map_index(handle.value)];
+    Uint32 batch = SDL_GetAtomicU32(&mesh_resource->ready_batch);
+
+    // Dynamic meshes are uploaded by the frame that draws them
+    if (mesh_dynamic(mesh_resource)) {
+        return batch != 0;
+    }
+
+    return batch != 0 && batch <= SDL_GetAtomicU32(&renderer->staging.completed_batch);
+}
+
+bool renderer_is_texture_ready(Renderer* renderer, TextureHandle handle)
+{
+    if (!slot_map_is_live(&renderer->texture_storage.slots, handle.value)) {
+        return false;
+    }
+
+    Uint32 batch = SDL_GetAtomicU32(&renderer->texture_storage.textures[slot_map_index(handle.value)].ready_batch);
+    return batch != 0 && batch <= SDL_GetAtomicU32(&renderer->staging.completed_batch);
+}
+
+MeshHandle renderer_create_dynamic_mesh(Renderer* renderer, Uint32 max_vertices, Uint32 max_indices)
+{
+    if (max_vertices == 0 || max_indices == 0) {
+        log_err("Empty mesh");
+        return MeshHandle::invalid();
+    }
+
+    // Indices are 16 bit and relative to the region
+    if (max_vertices > UINT16_MAX + 1) {
+        log_err("Dynamic mesh has more than %u vertices", UINT16_MAX + 1);
+        return MeshHandle::invalid();
+    }
+
+    Uint32 handle = slot_map_alloc(&renderer->mesh_storage.slots);
+    if (!handle) {
+        log_err("Mesh storage full");
+        return MeshHandle::invalid();
+    }
+
+    Uint32 buffer_size = max_vertices * (Uint32)sizeof(Vertex) + max_indices * (Uint32)sizeof(uint16_t);
+
+    auto* dynamic = (DynamicMesh*)SDL_calloc(1, sizeof(DynamicMesh));
+    if (dynamic) {
+        dynamic->buffers = (uint8_t*)SDL_malloc(DYNAMIC_MESH_BUFFERS * buffer_size);
+    }
+
+    if (!dynamic || !dynamic->buffers) {
+        log_err("Out of memory");
+        SDL_free(dynamic);
+        slot_map_retire(&renderer->mesh_storage.slots, handle);
+        slot_map_release(&renderer->mesh_storage.slots, handle);
+        return MeshHandle::invalid();
+    }
+
+    dynamic->max_vertices = max_vertices;
+    dynamic->max_indices = max_indices;
+    dynamic->buffer_size = buffer_size;
+    dynamic->write_buffer = 0;
+    SDL_SetAtomicU32(&dynamic->committed, 1);
+    dynamic->read_buffer = 2;
+
+    // Set before the handle is returned so it can be mapped right away
+    MeshResource* mesh_resource = &renderer->mesh_storage.meshes[slot_map_index(handle)];
+    mesh_set_dynamic(mesh_resource, dynamic);
+
+    UploadRequest request = {};
+    request.type = UPLOAD_REQUEST_DYNAMIC_MESH;
+    request.handle = handle;
+    request.vertices_count = max_vertices;
+    request.indices_count = max_indices;
+
+    if (!upload_queue_push(&renderer->upload_queue, &request)) {
+        log_err("Out of memory");
+        mesh_set_dynamic(mesh_resource, NULL);
+        SDL_free(dynamic->buffers);
+        SDL_free(dynamic);
+        slot_map_retire(&renderer->mesh_storage.slots, handle);
+        slot_map_release(&renderer->mesh_storage.slots, handle);
+        return MeshHandle::invalid();
+    }
+
+    return MeshHandle(handle);
+}
+
+static DynamicMesh* live_dynamic_mesh(Renderer* renderer, MeshHandle handle)
+{
+    if (!slot_map_is_live(&renderer->mesh_storage.slots, handle.value)) {
+        log_warn("Using a stale mesh handle");
+        return NULL;
+    }
+
+    DynamicMesh* dynamic = mesh_dynamic(&renderer->mesh_storage.meshes[slot_map_index(handle.value)]);
+    if (!dynamic) {
+        log_err("Mesh is not dynamic");
+    }
+
+    return dynamic;
+}
+
+bool renderer_map_dynamic_mesh(Renderer* renderer, MeshHandle handle, MeshData* out_mesh_data)
+{
+    DynamicMesh* dynamic = live_dynamic_mesh(renderer, handle);
+    if (!dynamic) {
+        return false;
+    }
+
+    uint8_t* buffer = dynamic->buffers + dynamic->write_buffer * dynamic->buffer_size;
+
+    out_mesh_data->vertices = (Vertex*)buffer;
+    out_mesh_data->vertices_count = dynamic->max_vertices;
+    out_mesh_data->indices = (uint16_t*)(buffer + dynamic->max_vertices * sizeof(Vertex));
+    out_mesh_data->indices_count = dynamic->max_indices;
+
+    return true;
+}
+
+void renderer_commit_dynamic_mesh(Renderer* renderer, MeshHandle handle, Uint32 vertices_count, Uint32 indices_count)
+{
+    DynamicMesh* dynamic = live_dynamic_mesh(renderer, handle);
+    if (!dynamic) {
+        return;
+    }
+
+    dynamic->vertices_count[dynamic->write_buffer] = SDL_min(vertices_count, dynamic->max_vertices);
+    dynamic->indices_count[dynamic->write_buffer] = SDL_min(indices_count, dynamic->max_indices);
+
+    // The buffer committed before, whether latched or not, is the next one written
+    Uint32 previous = SDL_SetAtomicU32(&dynamic->committed, dynamic->write_buffer | DYNAMIC_MESH_FRESH);
+    dynamic->write_buffer = previous & ~DYNAMIC_MESH_FRESH;
+}
+
+// Vertices, positions, bounds and indices, kept 4 byte aligned for the next mesh
+static Uint32 dynamic_mesh_upload_size(Uint32 vertices_count, Uint32 indices_count)
+{
+    Uint32 size = vertices_count * (Uint32)(sizeof(Vertex) + sizeof(glm::vec3)) + (Uint32)sizeof(glm::vec4)
+        + indices_count * (Uint32)sizeof(uint16_t);
+    return (size + 3) & ~3u;
+}
+
+static bool dynamic_meshes_reserve(Renderer* renderer, Uint32 size)
+{
+    DynamicMeshList* list = &renderer->dynamic_meshes;
+
+    if (list->transfer_buffer && size <= list->transfer_capacity) {
+        return true;
+    }
+
+    Uint32 capacity = list->transfer_capacity == 0 ? 64 * 1024 : list->transfer_capacity;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+
+    SDL_ReleaseGPUTransferBuffer(renderer->device, list->transfer_buffer);
+    list->transfer_capacity = 0;
+
+    SDL_GPUTransferBufferCreateInfo transfer_buffer_create_info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = capacity,
+    };
+
+    list->transfer_buffer = SDL_CreateGPUTransferBuffer(renderer->device, &transfer_buffer_create_info);
+    if (!list->transfer_buffer) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
+
+    list->transfer_capacity = capacity;
+
+    return true;
+}
+
+// Takes the latest commit of every dynamic mesh and stages it. The mesh then
+// points at the region it is uploaded to, which the draws of this frame use.
+static void dynamic_meshes_latch(Renderer* renderer)
+{
+    DynamicMeshList* list = &renderer->dynamic_meshes;
+    Uint32 transfer_size = 0;
+
+    for (size_t i = 0; i < list->count; i++) {
+        DynamicMesh* dynamic = mesh_dynamic(&renderer->mesh_storage.meshes[slot_map_index(list->handles[i])]);
+        dynamic->upload_pending = false;
+
+        if (!(SDL_GetAtomicU32(&dynamic->committed) & DYNAMIC_MESH_FRESH)) {
+            continue;
+        }
+
+        Uint32 previous = SDL_SetAtomicU32(&dynamic->committed, dynamic->read_buffer);
+        dynamic->read_buffer = previous & ~DYNAMIC_MESH_FRESH;
+
+        dynamic->upload_pending = true;
+        dynamic->transfer_offset = transfer_size;
+        transfer_size += dynamic_mesh_upload_size(dynamic->vertices_count[dynamic->read_buffer], dynamic->indices_count[dynamic->read_buffer]);
+    }
+
+    if (transfer_size == 0) {
+        return;
+    }
+
+    uint8_t* mapped = NULL;
+
+    // Frames in flight may still be copying from the previous contents
+    if (dynamic_meshes_reserve(renderer, transfer_size)) {
+        mapped = (uint8_t*)SDL_MapGPUTransferBuffer(renderer->device, list->transfer_buffer, true);
+        if (!mapped) {
+            log_err("%s", SDL_GetError());
+        }
+    }
+
+    for (size_t i = 0; i < list->count; i++) {
+        MeshResource* mesh_resource = &renderer->mesh_storage.meshes[slot_map_index(list->handles[i])];
+        DynamicMesh* dynamic = mesh_dynamic(mesh_resource);
+
+        if (!dynamic->upload_pending) {
+            continue;
+        }
+
+        // The commit is dropped, the mesh keeps drawing its previous contents
+        if (!mapped) {
+            dynamic->upload_pending = false;
+            continue;
+        }
+
+        Uint32 vertices_count = dynamic->vertices_count[dynamic->read_buffer];
+        Uint32 indices_count = dynamic->indices_count[dynamic->read_buffer];
+
+        const uint8_t* buffer = dynamic->buffers + dynamic->read_buffer * dynamic->buffer_size;
+        auto* vertices = (const Vertex*)buffer;
+
+        uint8_t* staging_data = mapped + dynamic->transfer_offset;
+        Uint32 vertices_size = vertices_count * (Uint32)sizeof(Vertex);
+        Uint32 positions_size = vertices_count * (Uint32)sizeof(glm::vec3);
+
+        auto* positions = (glm::vec3*)(staging_data + vertices_size);
+        auto* bounds = (glm::vec4*)(staging_data + vertices_size + positions_size);
+
+        memcpy(staging_data, vertices, vertices_size);
+
+        glm::vec3 bounds_min = vertices_count > 0 ? vertices[0].position : glm::vec3(0.0f);
+        glm::vec3 bounds_max = bounds_min;
+
+        for (Uint32 v = 0; v < vertices_count; v++) {
+            positions[v] = vertices[v].position;
+            bounds_min = glm::min(bounds_min, vertices[v].position);
+            bounds_max = glm::max(bounds_max, vertices[v].position);
+        }
+
+        mesh_resource->bounds_center = (bounds_min + bounds_max) * 0.5f;
+        mesh_resource->bounds_radius = glm::length(bounds_max - bounds_min) * 0.5f;
+        *bounds = glm::vec4(mesh_resource->bounds_center, mesh_resource->bounds_radius);
+
+        memcpy(staging_data + vertices_size + positions_size + sizeof(glm::vec4), buffer + dynamic->max_vertices * sizeof(Vertex),
+            indices_count * sizeof(uint16_t));
+
+        dynamic->region = (dynamic->region + 1) % DRAW_DATA_RING_FRAMES;
+
+        mesh_resource->vertex_offset = dynamic->vertex_base + dynamic->region * dynamic->max_vertices;
+        mesh_resource->vertices_count = vertices_count;
+        mesh_resource->first_index = dynamic->index_base + dynamic->region * dynamic->max_indices;
+        mesh_resource->indices_count = indices_count;
+
+        SDL_SetAtomicU32(&mesh_resource->ready_batch, 1);
+    }
+
+    if (mapped) {
+        SDL_UnmapGPUTransferBuffer(renderer->device, list->transfer_buffer);
+    }
+}
+
+static void dynamic_mesh_copy(Renderer* renderer, SDL_GPUCopyPass* copy_pass, Uint32 transfer_offset, SDL_GPUBuffer* buffer, Uint32 offset, Uint32 size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    SDL_GPUTransferBufferLocation location = {
+        .transfer_buffer = renderer->dynamic_meshes.transfer_buffer,
+        .offset = transfer_offset,
+    };
+
+    SDL_GPUBufferRegion region = {
+        .buffer = buffer,
+        .offset = offset,
+        .size = size,
+    };
+
+    SDL_UploadToGPUBuffer(copy_pass, &location, &region, false);
+
+    renderer->stats.upload_bytes += size;
+}
+
+// Copies what dynamic_meshes_latch staged into the regions the meshes now point at
+static void dynamic_meshes_upload(Renderer* renderer, SDL_GPUCommandBuffer* command_buffer)
+{
+    DynamicMeshList* list = &renderer->dynamic_meshes;
+    MeshPool* pool = &renderer->mesh_pool;
+    SDL_GPUCopyPass* copy_pass = NULL;
+
+    for (size_t i = 0; i < list->count; i++) {
+        Uint32 mesh_index = slot_map_index(list->handles[i]);
+        MeshResource* mesh_resource = &renderer->mesh_storage.meshes[mesh_index];
+        DynamicMesh* dynamic = mesh_dynamic(mesh_resource);
+
+        if (!dynamic->upload_pending) {
+            continue;
+        }
+
+        if (!copy_pass) {
+            copy_pass = SDL_BeginGPUCopyPass(command_buffer);
+        }
+
+        Uint32 vertices_size = mesh_resource->vertices_count * (Uint32)sizeof(Vertex);
+        Uint32 positions_size = mesh_resource->vertices_count * (Uint32)sizeof(glm::vec3);
+        Uint32 offset = dynamic->transfer_offset;
+
+        dynamic_mesh_copy(renderer, copy_pass, offset, pool->vertex_buffer,
+            mesh_resource->vertex_offset * (Uint32)sizeof(Vertex), vertices_size);
+        dynamic_mesh_copy(renderer, copy_pass, offset + vertices_size, pool->position_buffer,
+            mesh_resource->vertex_offset * (Uint32)sizeof(glm::vec3), positions_size);
+
+        if (renderer->culling.mesh_bounds_buffer) {
+            dynamic_mesh_copy(renderer, copy_pass, offset + vertices_size + positions_size, renderer->culling.mesh_bounds_buffer,
+                mesh_index * (Uint32)sizeof(glm::vec4), sizeof(glm::vec4));
+        }
+
+        dynamic_mesh_copy(renderer, copy_pass, offset + vertices_size + positions_size + sizeof(glm::vec4), pool->index_buffer,
+            mesh_resource->first_index * (Uint32)sizeof(uint16_t), mesh_resource->indices_count * (Uint32)sizeof(uint16_t));
+
+        dynamic->upload_pending = false;
+    }
+
+    if (copy_pass) {
+        SDL_EndGPUCopyPass(copy_pass);
+    }
+}
+
+MaterialHandle renderer_create_material(Renderer* renderer, TextureHandle albedo, MaterialFlags flags)
+{
+    Uint32 handle = slot_map_alloc(&renderer->material_storage.slots);
+    if (!handle) {
+        log_err("Material storage full");
+        return MaterialHandle::invalid();
+    }
+
+    UploadRequest request = {};
+    request.type = UPLOAD_REQUEST_MATERIAL;
+    request.handle = handle;
+    request.albedo = albedo.value;
+    request.material_flags = flags;
+
+    if (!upload_queue_push(&renderer->upload_queue, &request)) {
+        log_err("Out of memory");
+        slot_map_retire(&renderer->material_storage.slots, handle);
+        slot_map_release(&renderer->material_storage.slots, handle);
+        return MaterialHandle::invalid();
+    }
+
+    return MaterialHandle(handle);
+}
+
+bool renderer_is_material_ready(Renderer* renderer, MaterialHandle handle)
+{
+    if (!slot_map_is_live(&renderer->material_storage.slots, handle.value)) {
+        return false;
     }
 
-    // bool supports_mailbox = SDL_WindowSupportsGPUPresentMode(renderer->device, renderer->window, SDL_GPU_PRESENTMODE_MAILBOX);
-    SDL_SetGPUSwapchainParameters(renderer->device, renderer->window, SDL_GPU_SWAPCHAINCOMPOSITION_SDR, SDL_GPU_PRESENTMODE_VSYNC);
-
-    SDL_GPUShader* vertex_shader = load_shader(renderer->device, "shaders/vert.spv", SDL_GPU_SHADERSTAGE_VERTEX, 1, 0);
-    SDL_GPUShader* fragment_shader = load_shader(renderer->device, "shaders/frag.spv", SDL_GPU_SHADERSTAGE_FRAGMENT, 0, 1);
+    Uint32 batch = SDL_GetAtomicU32(&renderer->material_storage.materials[slot_map_index(handle.value)].ready_batch);
+    return batch != 0 && batch <= SDL_GetAtomicU32(&renderer->staging.completed_batch);
+}
 
-    SDL_GPUGraphicsPipelineCreateInfo pipeline_create_info = {};
-    pipeline_create_info.vertex_shader = vertex_shader;
-    pipeline_create_info.fragment_shader = fragment_shader;
-    pipeline_create_info.primitive_type = SDL_GPU_PRIMITIVETYPE_TRIANGLELIST;
-    pipeline_create_info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_LINE;
+static bool draw_data_reserve(Renderer* renderer, Uint32 count)
+{
+    DrawDataRing* ring = &renderer->draw_data;
 
-    SDL_GPUVertexBufferDescription vertex_buffer_description[1] = {};
-    vertex_buffer_description[0].slot = 0;
-    vertex_buffer_description[0].input_rate = SDL_GPU_VERTEXINPUTRATE_VERTEX;
-    vertex_buffer_description[0].instance_step_rate = 0;
-    vertex_buffer_description[0].pitch = sizeof(Vertex);
+    if (ring->buffer && count <= ring->capacity) {
+        return true;
+    }
 
-    pipeline_create_info.vertex_input_state.num_vertex_buffers = 1;
-    pipeline_create_info.vertex_input_state.vertex_buffer_descriptions = vertex_buffer_description;
+    Uint32 capacity = ring->capacity == 0 ? 1024 : ring->capacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
 
-    SDL_GPUVertexAttribute vertex_attributes[2] = {};
-    vertex_attributes[0].buffer_slot = 0;
-    vertex_attributes[0].location = 0;
-    vertex_attributes[0].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
-    vertex_attributes[0].offset = offsetof(Vertex, position);
+    const Transform** transforms = (const Transform**)SDL_realloc(ring->transforms, capacity * sizeof(Transform*));
+    if (!transforms) {
+        return false;
+    }
+    ring->transforms = transforms;
+
+    // Frames still in flight keep the old buffers alive until they complete
+    if (ring->buffer) {
+        SDL_ReleaseGPUBuffer(renderer->device, ring->buffer);
+        SDL_ReleaseGPUTransferBuffer(renderer->device, ring->transfer_buffer);
+        ring->buffer = NULL;
+        ring->transfer_buffer = NULL;
+        ring->capacity = 0;
+    }
 
-    // UV attribute
-    vertex_attributes[1].buffer_slot = 0;
-    vertex_attributes[1].location = 1;
-    vertex_attributes[1].format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2;
-    vertex_attributes[1].offset = offsetof(Vertex, texcoords);
+    Uint32 size = DRAW_DATA_RING_FRAMES * capacity * (Uint32)sizeof(DrawData);
 
-    pipeline_create_info.vertex_input_state.num_vertex_attributes = 2;
-    pipeline_create_info.vertex_input_state.vertex_attributes = vertex_attributes;
+    // Read by the vertex shaders directly, or by the cull pass with GPU culling
+    SDL_GPUBufferCreateInfo buffer_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+        .size = size,
+    };
 
-    SDL_GPUColorTargetDescription color_target_descriptions[1] = {};
-    color_target_descriptions[0].format = SDL_GetGPUSwapchainTextureFormat(renderer->device, window);
+    ring->buffer = SDL_CreateGPUBuffer(renderer->device, &buffer_create_info);
+    if (!ring->buffer) {
+        log_err("%s", SDL_GetError());
+        return false;
+    }
 
-    pipeline_create_info.target_info.num_color_targets = 1;
-    pipeline_create_info.target_info.color_target_descriptions = color_target_descriptions;
-    pipeline_create_info.target_info.depth_stencil_format = SDL_GPU_TEXTUREFORMAT_D32_FLOAT;
-    pipeline_create_info.target_info.has_depth_stencil_target = true;
+    SDL_GPUTransferBufferCreateInfo transfer_buffer_create_info = {
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = size,
+    };
 
-    pipeline_create_info.rasterizer_state.fill_mode = SDL_GPU_FILLMODE_FILL;
+    ring->transfer_buffer = SDL_CreateGPUTransferBuffer(renderer->device, &transfer_buffer_create_info);
+    if (!ring->transfer_buffer) {
+        log_err("%s", SDL_GetError());
+        SDL_ReleaseGPUBuffer(renderer->device, ring->buffer);
+        ring->buffer = NULL;
+        return false;
+    }
 
-    pipeline_create_info.multisample_state.sample_count = SDL_GPU_SAMPLECOUNT_4;
+    ring->capacity = capacity;
+    ring->frame = 0;
 
-    SDL_GPUDepthStencilState depth_stencil_state = {
-        .compare_op = SDL_GPU_COMPAREOP_LESS,
-        .back_stencil_state = {
-            .compare_op = SDL_GPU_COMPAREOP_ALWAYS },
-        .front_stencil_state = { .compare_op = SDL_GPU_COMPAREOP_ALWAYS },
-        .compare_mask = 0,
-        .write_mask = 0,
-        .enable_depth_test = true,
-        .enable_depth_write = true,
-        .enable_stencil_test = false
-    };
+    return true;
+}
 
-    pipeline_create_info.depth_stencil_state = depth_stencil_state;
+static bool draw_batches_reserve(DrawBatchList* batches, size_t count)
+{
+    if (count <= batches->capacity) {
+        return true;
+    }
 
-    renderer->graphics_pipeline = SDL_CreateGPUGraphicsPipeline(renderer->device, &pipeline_create_info);
+    size_t capacity = batches->capacity == 0 ? 1024 : batches->capacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
 
-    if (!renderer->graphics_pipeline) {
-        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Could not create graphics pipeline: %s\n", SDL_GetError());
+    DrawBatch* new_batches = (DrawBatch*)SDL_realloc(batches->batches, capacity * sizeof(DrawBatch));
+    if (!new_batches) {
         return false;
     }
 
-    SDL_ReleaseGPUShader(renderer->device, vertex_shader);
-    SDL_ReleaseGPUShader(renderer->device, fragment_shader);
+    batches->batches = new_batches;
+    batches->capacity = capacity;
 
-    int width, height;
-    SDL_GetWindowSize(window, &width, &height);
+    return true;
+}
 
-    SDL_GPUTextureCreateInfo depth_texture_create_info = {
-        .type = SDL_GPU_TEXTURETYPE_2D,
-        .layer_count_or_depth = 1,
-        .num_levels = 1,
-        .format = SDL_GPU_TEXTUREFORMAT_D32_FLOAT,
-        .width = static_cast<Uint32>(width),
-        .height = static_cast<Uint32>(height),
-        .usage = SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET,
-        .sample_count = SDL_GPU_SAMPLECOUNT_4,
-    };
+static bool draw_command_table_reserve(DrawCommandTable* table, size_t count)
+{
+    if (count <= table->capacity) {
+        return true;
+    }
 
-    renderer->depth_texture = SDL_CreateGPUTexture(renderer->device, &depth_texture_create_info);
+    size_t capacity = table->capacity == 0 ? 1024 : table->capacity;
+    while (capacity < count) {
+        capacity *= 2;
+    }
 
-    if (!renderer->depth_texture) {
-        SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Failed to create depth texture: %s", SDL_GetError());
+    auto* new_commands = (const DrawCommandHeader**)SDL_realloc(table->commands, capacity * sizeof(DrawCommandHeader*));
+    if (!new_commands) {
+        return false;
     }
 
-    SDL_GPUTextureCreateInfo msaa_texture_info = {
-        .type = SDL_GPU_TEXTURETYPE_2D,
-        .format = SDL_GetGPUSwapchainTextureFormat(renderer->device, renderer->window),
-        .usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET,
-        .width = static_cast<Uint32>(width),
-        .height = static_cast<Uint32>(height),
-        .layer_count_or_depth = 1,
-        .num_levels = 1,
-        .sample_count = SDL_GPU_SAMPLECOUNT_4,
-    };
-    renderer->msaa_texture = SDL_CreateGPUTexture(renderer->device, &msaa_texture_info);
+    table->commands = new_commands;
+    table->capacity = capacity;
 
-    SDL_GPUSamplerCreateInfo sampler_info = {
-        .min_filter = SDL_GPU_FILTER_NEAREST,
-        .mag_filter = SDL_GPU_FILTER_NEAREST,
-        .mipmap_mode = SDL_GPU_SAMPLERMIPMAPMODE_NEAREST,
-        .address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_REPEAT,
-        .address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_REPEAT,
-        .address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_REPEAT,
-    };
+    return true;
+}
 
-    renderer->texture_sampler = SDL_CreateGPUSampler(renderer->device, &sampler_info);
+// Counts how often pass, pipeline or material differ between consecutive keys
+static Uint32 count_state_changes(const Uint64* keys, size_t count)
+{
+    Uint32 changes = 0;
+    Uint64 previous_state = ~0ull;
 
-    renderer->mesh_storage.capacity = 1024 * 10;
-    renderer->mesh_storage.meshes = (MeshResource*)SDL_malloc(renderer->mesh_storage.capacity);
+    for (size_t i = 0; i < count; i++) {
+        Uint64 state = keys[i] >> SORT_KEY_MATERIAL_SHIFT;
 
-    renderer->texture_storage.capacity = 1024 * 10;
-    renderer->texture_storage.textures = (TextureResource*)SDL_malloc(renderer->texture_storage.capacity);
+        if (state != previous_state) {
+            changes++;
+            previous_state = state;
+        }
+    }
 
-    renderer->projection_matrix = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 1.0f, 4096.0f);
+    return changes;
+}
 
-    return true;
+static void submit_command_buffer(Renderer* renderer, SDL_GPUCommandBuffer* command_buffer)
+{
+    Uint64 submit_start = SDL_GetPerformanceCounter();
+    SDL_SubmitGPUCommandBuffer(command_buffer);
+    renderer->submit_ticks += SDL_GetPerformanceCounter() - submit_start;
 }
 
-MeshHandle renderer_create_mesh(Renderer* renderer, MeshData* mesh_data)
+#ifdef ALMOND_DEBUG_DRAW
+static bool debug_lines_reserve(Renderer* renderer, Uint32 vertex_count)
 {
-    if (renderer->mesh_storage.capacity <= renderer->mesh_storage.count) {
-        log_err("Mesh storage full");
-        return MeshHandle::invalid();
+    DebugLineBuffer* lines = &renderer->debug_lines;
+
+    if (lines->buffer && vertex_count <= lines->capacity) {
+        return true;
     }
 
-    if (mesh_data->indices_count == 0 || mesh_data->vertices_count == 0) {
-        log_err("Empty mesh");
-        return MeshHandle::invalid();
+    Uint32 capacity = lines->capacity == 0 ? 4096 : lines->capacity;
+    while (capacity < vertex_count) {
+        capacity *= 2;
     }
 
-    Uint32 vertices_size = mesh_data->vertices_count * sizeof(*mesh_data->vertices);
-    Uint32 indices_size = mesh_data->indices_count * sizeof(*mesh_data->indices);
+    // Frames still in flight keep the old buffers alive until they complete
+    SDL_ReleaseGPUBuffer(renderer->device, lines->buffer);
+    SDL_ReleaseGPUTransferBuffer(renderer->device, lines->transfer_buffer);
+    lines->capacity = 0;
 
-    SDL_GPUTransferBufferCreateInfo transfer_info = {
-        .size = vertices_size + indices_size,
+    SDL_GPUBufferCreateInfo buffer_create_info = {
+        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
+        .size = capacity * (Uint32)sizeof(DebugVertex),
+    };
+
+    SDL_GPUTransferBufferCreateInfo transfer_buffer_create_info = {
         .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = capacity * (Uint32)sizeof(DebugVertex),
     };
 
-    SDL_GPUTransferBuffer* transfer_buffer = SDL_CreateGPUTransferBuffer(renderer->device, &transfer_info);
-    if (!transfer_buffer) {
-        log_err("%s", SDL_GetError());
-        return MeshHandle::invalid();
-    }
+    lines->buffer = SDL_CreateGPUBuffer(renderer->device, &buffer_create_info);
+    lines->transfer_buffer = SDL_CreateGPUTransferBuffer(renderer->device, &transfer_buffer_create_info);
 
-    uint8_t* transfer_data = (uint8_t*)SDL_MapGPUTransferBuffer(renderer->device, transfer_buffer, false);
-    if (!transfer_data) {
+    if (!lines->buffer || !lines->transfer_buffer) {
         log_err("%s", SDL_GetError());
-        SDL_ReleaseGPUTransferBuffer(renderer->device, transfer_buffer);
-        return MeshHandle::invalid();
+        SDL_ReleaseGPUBuffer(renderer->device, lines->buffer);
+        SDL_ReleaseGPUTransferBuffer(renderer->device, lines->transfer_buffer);
+        lines->buffer = NULL;
+        lines->transfer_buffer = NULL;
+        return false;
     }
 
-    memcpy(transfer_data, mesh_data->vertices, vertices_size);
-    memcpy(transfer_data + vertices_size, mesh_data->indices, indices_size);
+    lines->capacity = capacity;
 
-    SDL_UnmapGPUTransferBuffer(renderer->device, transfer_buffer);
+    return true;
+}
 
-    SDL_GPUCommandBuffer* command_buffer = SDL_AcquireGPUCommandBuffer(renderer->device);
-    if (!command_buffer) {
-        log_err("%s", SDL_GetError());
-        SDL_ReleaseGPUTransferBuffer(renderer->device, transfer_buffer);
-        return MeshHandle::invalid();
+// Copies the vertices of every DebugLines command into the line buffer and
+// returns how many there are to draw
+static Uint32 debug_lines_upload(Renderer* renderer, SDL_GPUCommandBuffer* command_buffer, size_t command_count)
+{
+    DrawCommandTable* table = &renderer->draw_commands;
+    Uint32 vertex_count = 0;
+
+    for (size_t i = 0; i < command_count; i++) {
+        if (table->commands[i]->type == DrawCommandType::DebugLines) {
+            vertex_count += draw_command_payload<DebugLinesCommand>(table->commands[i])->vertex_count;
+        }
     }
 
-    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
-    if (!copy_pass) {
-        log_err("%s", SDL_GetError());
-        SDL_ReleaseGPUTransferBuffer(renderer->device, transfer_buffer);
-        return MeshHandle::invalid();
+    if (vertex_count == 0 || !renderer->debug_lines_pipeline || !debug_lines_reserve(renderer, vertex_count)) {
+        return 0;
     }
 
-    SDL_GPUBufferCreateInfo vertex_buffer_create_info = {
-        .size = vertices_size,
-        .usage = SDL_GPU_BUFFERUSAGE_VERTEX,
-    };
+    DebugLineBuffer* lines = &renderer->debug_lines;
 
-    SDL_GPUBuffer* vertex_buffer = SDL_CreateGPUBuffer(renderer->device, &vertex_buffer_create_info);
-    if (!vertex_buffer) {
+    auto* mapped = (DebugVertex*)SDL_MapGPUTransferBuffer(renderer->device, lines->transfer_buffer, true);
+    if (!mapped) {
         log_err("%s", SDL_GetError());
-        SDL_EndGPUCopyPass(copy_pass);
-        SDL_ReleaseGPUTransferBuffer(renderer->device, transfer_buffer);
-        return MeshHandle::invalid();
+        return 0;
     }
 
-    SDL_GPUTransferBufferLocation vertex_buffer_location = {
-        .transfer_buffer = transfer_buffer,
+    for (size_t i = 0; i < command_count; i++) {
+        const DrawCommandHeader* header = table->commands[i];
+
+        if (header->type == DrawCommandType::DebugLines) {
+            auto* cmd = draw_command_payload<DebugLinesCommand>(header);
+            memcpy(mapped, (const uint8_t*)(cmd + 1), cmd->vertex_count * sizeof(DebugVertex));
+            mapped += cmd->vertex_count;
+        }
+    }
+
+    SDL_UnmapGPUTransferBuffer(renderer->device, lines->transfer_buffer);
+
+    SDL_GPUTransferBufferLocation location = {
+        .transfer_buffer = lines->transfer_buffer,
         .offset = 0,
     };
 
-    SDL_GPUBufferRegion vertex_buffer_region = {
-        .buffer = vertex_buffer,
-        .size = vertices_size,
+    SDL_GPUBufferRegion region = {
+        .buffer = lines->buffer,
         .offset = 0,
+        .size = vertex_count * (Uint32)sizeof(DebugVertex),
     };
 
-    SDL_UploadToGPUBuffer(copy_pass, &vertex_buffer_location, &vertex_buffer_region, true);
+    // The previous frame may still draw from the buffer
+    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
+    SDL_UploadToGPUBuffer(copy_pass, &location, &region, true);
+    SDL_EndGPUCopyPass(copy_pass);
 
-    SDL_GPUBufferCreateInfo index_buffer_create_info = {
-        .size = indices_size,
-        .usage = SDL_GPU_BUFFERUSAGE_INDEX,
-    };
+    renderer->stats.upload_bytes += region.size;
 
-    SDL_GPUBuffer* index_buffer = SDL_CreateGPUBuffer(renderer->device, &index_buffer_create_info);
-    if (!index_buffer) {
-        log_err("%s", SDL_GetError());
-        SDL_ReleaseGPUBuffer(renderer->device, vertex_buffer);
-        SDL_EndGPUCopyPass(copy_pass);
-        SDL_ReleaseGPUTransferBuffer(renderer->device, transfer_buffer);
-        return MeshHandle::invalid();
+    return vertex_count;
+}
+#endif
+
+// Material of a draw, NULL when it uses the default
+static MaterialResource* draw_material(Renderer* renderer, MaterialHandle handle)
+{
+    if (!renderer_is_material_ready(renderer, handle)) {
+        return NULL;
     }
 
-    SDL_GPUTransferBufferLocation index_buffer_location = {
-        .transfer_buffer = transfer_buffer,
-        .offset = static_cast<Uint32>(vertices_size),
-    };
+    return &renderer->material_storage.materials[slot_map_index(handle.value)];
+}
 
-    SDL_GPUBufferRegion index_buffer_region = {
-        .buffer = index_buffer,
-        .size = static_cast<Uint32>(indices_size),
-        .offset = 0,
-    };
+// Issues batches [first, last) with whatever pipeline is bound. Indirect draws
+// read the commands the cull pass wrote, consecutive batches sharing a texture
+// array go out as one call. Instances and triangles are counted before culling.
+static void record_batches(Renderer* renderer, SDL_GPURenderPass* render_pass, size_t first, size_t last, bool bind_textures, bool indirect)
+{
+    DrawBatchList* batches = &renderer->draw_batches;
 
-    SDL_UploadToGPUBuffer(copy_pass, &index_buffer_location, &index_buffer_region, true);
+    for (size_t i = first; i < last;) {
+        DrawBatch* batch = &batches->batches[i];
 
-    SDL_EndGPUCopyPass(copy_pass);
-    SDL_SubmitGPUCommandBuffer(command_buffer);
+        if (bind_textures) {
+            render_state_bind_fragment_sampler(&renderer->render_state, batch->texture_array, renderer->texture_sampler);
+        }
+
+        size_t end = i + 1;
 
-    SDL_ReleaseGPUTransferBuffer(renderer->device, transfer_buffer);
+        if (indirect) {
+            while (end < last && (!bind_textures || batches->batches[end].texture_array == batch->texture_array)) {
+                end++;
+            }
+
+            SDL_DrawGPUIndexedPrimitivesIndirect(render_pass, renderer->culling.indirect_buffer,
+                (Uint32)(i * sizeof(SDL_GPUIndexedIndirectDrawCommand)), (Uint32)(end - i));
+        } else {
+            SDL_DrawGPUIndexedPrimitives(render_pass, batch->mesh->indices_count, batch->instance_count,
+                batch->mesh->first_index, (Sint32)batch->mesh->vertex_offset, batch->first_instance);
+        }
 
-    MeshResource* mesh_resource = &renderer->mesh_storage.meshes[renderer->mesh_storage.count++];
-    mesh_resource->handle = MeshHandle(renderer->mesh_storage.count);
-    mesh_resource->vertex_buffer = vertex_buffer;
-    mesh_resource->index_buffer = index_buffer;
-    mesh_resource->indices_count = mesh_data->indices_count;
+        renderer->stats.draw_calls++;
 
-    return mesh_resource->handle;
+        for (; i < end; i++) {
+            batch = &batches->batches[i];
+            renderer->stats.instances += batch->instance_count;
+            renderer->stats.triangles += batch->mesh->indices_count / 3 * batch->instance_count;
+        }
+    }
 }
 
-TextureHandle renderer_create_texture(Renderer* renderer, const uint8_t* rgba_data, uint32_t width, uint32_t height)
+static void record_draw_list(Renderer* renderer, DrawList* draw_list)
 {
-    SDL_GPUTextureCreateInfo texture_create_info = {};
-    texture_create_info.type = SDL_GPU_TEXTURETYPE_2D;
-    texture_create_info.format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
-    texture_create_info.width = width;
-    texture_create_info.height = height;
-    texture_create_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
-    texture_create_info.layer_count_or_depth = 1;
-    texture_create_info.num_levels = 1;
-    texture_create_info.sample_count = SDL_GPU_SAMPLECOUNT_1;
+    pipeline_registry_update(&renderer->pipelines);
+    renderer_process_uploads(renderer);
+    dynamic_meshes_latch(renderer);
 
-    SDL_GPUTexture* texture = SDL_CreateGPUTexture(renderer->device, &texture_create_info);
-    if (!texture) {
-        log_err("%", SDL_GetError());
-        return TextureHandle::invalid();
+    DrawSortBuffers* sort = &renderer->draw_sort;
+    sort->count = 0;
+
+    DrawCommandTable* table = &renderer->draw_commands;
+
+    if (!draw_sort_reserve(sort, draw_list->count) || !draw_command_table_reserve(table, draw_list->count)) {
+        log_err("Could not grow draw sort buffers");
+        return;
     }
 
-    SDL_GPUTransferBufferCreateInfo transfer_buffer_create_info = {
-        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-        .size = width * height * 4,
-    };
+    // Sorted draws are looked up by index, the stream is walked once to find them
+    size_t command_count = 0;
+    DrawListIterator it = draw_list_begin(draw_list);
 
-    SDL_GPUTransferBuffer* transfer_buffer = SDL_CreateGPUTransferBuffer(renderer->device, &transfer_buffer_create_info);
-    if (!transfer_buffer) {
-        SDL_ReleaseGPUTexture(renderer->device, texture);
-        return TextureHandle::invalid();
+    while (const DrawCommandHeader* header = draw_list_next(draw_list, &it)) {
+        table->commands[command_count++] = header;
     }
 
-    void* transfer_data = SDL_MapGPUTransferBuffer(renderer->device, transfer_buffer, true);
+    for (size_t i = 0; i < command_count; i++) {
+        const DrawCommandHeader* header = table->commands[i];
 
-    if (!transfer_data) {
-        SDL_ReleaseGPUTransferBuffer(renderer->device, transfer_buffer);
-        SDL_ReleaseGPUTexture(renderer->device, texture);
-        return TextureHandle::invalid();
+        MeshHandle mesh_handle;
+        MaterialHandle material_handle;
+        glm::vec3 center;
+
+        switch (header->type) {
+        case DrawCommandType::DrawMesh: {
+            mesh_handle = draw_command_payload<DrawMeshCommand>(header)->mesh;
+            material_handle = draw_command_payload<DrawMeshCommand>(header)->material;
+        } break;
+        case DrawCommandType::DrawMeshMatrix: {
+            mesh_handle = draw_command_payload<DrawMeshMatrixCommand>(header)->mesh;
+            material_handle = draw_command_payload<DrawMeshMatrixCommand>(header)->material;
+        } break;
+        default:
+            continue;
+        }
+
+        // Meshes still in flight are skipped
+        if (!renderer_is_mesh_ready(renderer, mesh_handle)) {
+            continue;
+        }
+
+        MeshResource* mesh_resource = &renderer->mesh_storage.meshes[slot_map_index(mesh_handle.value)];
+
+        if (header->type == DrawCommandType::DrawMesh) {
+            const Transform* transform = &draw_command_payload<DrawMeshCommand>(header)->transform;
+            center = transform->position + transform->rotation * (transform->scale * mesh_resource->bounds_center);
+        } else {
+            center = glm::vec3(draw_command_payload<DrawMeshMatrixCommand>(header)->model_matrix * glm::vec4(mesh_resource->bounds_center, 1.0f));
+        }
+
+        float distance = glm::length(center - draw_list->camera.position);
+        Uint32 depth = (Uint32)(glm::clamp(distance / RENDERER_FAR_PLANE, 0.0f, 1.0f) * SORT_KEY_DEPTH_MAX);
+
+        // Draws sort by material, those still in flight share the default
+        MaterialResource* material_resource = draw_material(renderer, material_handle);
+        Uint32 pipeline = material_resource ? material_resource->pipeline : MATERIAL_PIPELINE_OPAQUE;
+        Uint32 material = material_resource ? slot_map_index(material_handle.value) + 1 : 0;
+
+        sort->keys[sort->count] = draw_sort_key(SORT_PASS_OPAQUE, pipeline, material, slot_map_index(mesh_handle.value) + 1, depth);
+        sort->indices[sort->count] = (Uint32)i;
+        sort->count++;
+    }
+
+    renderer->stats.state_changes_unsorted = count_state_changes(sort->keys, sort->count);
+    draw_sort(sort);
+    renderer->stats.state_changes_sorted = count_state_changes(sort->keys, sort->count);
+
+    if (!draw_data_reserve(renderer, (Uint32)sort->count) || !draw_batches_reserve(&renderer->draw_batches, sort->count)) {
+        log_err("Could not grow draw data buffers");
+        return;
     }
 
-    memcpy(transfer_data, rgba_data, width * height * 4);
+    DrawDataRing* ring = &renderer->draw_data;
+    ring->frame = (ring->frame + 1) % DRAW_DATA_RING_FRAMES;
 
-    SDL_UnmapGPUTransferBuffer(renderer->device, transfer_buffer);
+    Uint32 first_draw = ring->frame * ring->capacity;
 
-    SDL_GPUCommandBuffer* cmd = SDL_AcquireGPUCommandBuffer(renderer->device);
-    SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(cmd);
+    // Write one DrawData per draw and collapse runs sharing pipeline, mesh and texture array into batches
+    DrawBatchList* batches = &renderer->draw_batches;
+    batches->count = 0;
 
-    SDL_GPUTextureTransferInfo transfer_info = {
-        .offset = 0,
-        .pixels_per_row = width,
-        .rows_per_layer = height,
-        .transfer_buffer = transfer_buffer,
-    };
+    if (sort->count > 0) {
+        auto* mapped = (DrawData*)SDL_MapGPUTransferBuffer(renderer->device, ring->transfer_buffer, false);
+        if (!mapped) {
+            log_err("%s", SDL_GetError());
+            return;
+        }
 
-    SDL_GPUTextureRegion region = {
-        .w = width,
-        .h = height,
-        .d = 1,
-        .texture = texture,
-    };
+        DrawData* draw_data = mapped + first_draw;
 
-    SDL_UploadToGPUTexture(copy_pass, &transfer_info, &region, true);
+        // Precomputed matrices are written directly, the identity transform
+        // only keeps their slot in the batched conversion below
+        static const Transform identity_transform;
+        const Transform** transforms = ring->transforms;
 
-    SDL_EndGPUCopyPass(copy_pass);
-    SDL_SubmitGPUCommandBuffer(cmd);
+        for (size_t i = 0; i < sort->count; i++) {
+            const DrawCommandHeader* header = table->commands[sort->indices[i]];
+            transforms[i] = header->type == DrawCommandType::DrawMesh
+                ? &draw_command_payload<DrawMeshCommand>(header)->transform
+                : &identity_transform;
+        }
 
-    SDL_ReleaseGPUTransferBuffer(renderer->device, transfer_buffer);
+        transforms_to_matrices(transforms, &draw_data[0].model_matrix, sizeof(DrawData), sort->count);
 
-    TextureResource* texture_resource = &renderer->texture_storage.textures[renderer->texture_storage.count++];
-    texture_resource->handle = TextureHandle(renderer->texture_storage.count);
-    texture_resource->texture = texture;
+        DrawBatch* batch = NULL;
 
-    return texture_resource->handle;
-}
+        for (size_t i = 0; i < sort->count; i++) {
+            const DrawCommandHeader* header = table->commands[sort->indices[i]];
+
+            MeshHandle mesh_handle;
+            MaterialHandle material_handle;
+
+            if (header->type == DrawCommandType::DrawMesh) {
+                auto* cmd = draw_command_payload<DrawMeshCommand>(header);
+                mesh_handle = cmd->mesh;
+                material_handle = cmd->material;
+            } else {
+                auto* cmd = draw_command_payload<DrawMeshMatrixCommand>(header);
+                mesh_handle = cmd->mesh;
+                material_handle = cmd->material;
+                draw_data[i].model_matrix = cmd->model_matrix;
+            }
+
+            MeshResource* mesh_resource = &renderer->mesh_storage.meshes[slot_map_index(mesh_handle.value)];
+
+            MaterialResource* material_resource = draw_material(renderer, material_handle);
+            MaterialPipeline pipeline = material_resource ? material_resource->pipeline : MATERIAL_PIPELINE_OPAQUE;
+
+            // Textures still in flight fall back to a placeholder
+            SDL_GPUTexture* texture_array = renderer->fallback_texture;
+
+            if (material_resource && renderer_is_texture_ready(renderer, material_resource->albedo)) {
+                TextureResource* texture_resource = &renderer->texture_storage.textures[slot_map_index(material_resource->albedo.value)];
+                texture_array = renderer->texture_arrays.arrays[texture_resource->array_index].texture;
+            }
+
+            draw_data[i].material_index = material_resource ? slot_map_index(material_handle.value) + 1 : 0;
+            draw_data[i].mesh_index = slot_map_index(mesh_handle.value);
+
+            if (!batch || batch->pipeline != pipeline || batch->mesh != mesh_resource || batch->texture_array != texture_array) {
+                batch = &batches->batches[batches->count++];
+                batch->pipeline = pipeline;
+                batch->mesh = mesh_resource;
+                batch->texture_array = texture_array;
+                batch->first_instance = first_draw + (Uint32)i;
+                batch->instance_count = 0;
+            }
+
+            draw_data[i].batch_index = (Uint32)(batches->count - 1);
+            batch->instance_count++;
+        }
+
+        SDL_UnmapGPUTransferBuffer(renderer->device, ring->transfer_buffer);
+    }
+
+    bool gpu_culling = renderer->gpu_culling && renderer->culling.pipeline && sort->count > 0
+        && gpu_culling_reserve(renderer, (Uint32)sort->count);
 
-void renderer_play_draw_list(Renderer* renderer, DrawList* draw_list)
-{
     SDL_GPUCommandBuffer* command_buffer = SDL_AcquireGPUCommandBuffer(renderer->device);
 
+    dynamic_meshes_upload(renderer, command_buffer);
+
+    if (sort->count > 0) {
+        SDL_GPUCopyPass* copy_pass = SDL_BeginGPUCopyPass(command_buffer);
+
+        // Other regions may still be read by frames in flight, so no cycling
+        SDL_GPUTransferBufferLocation location = {
+            .transfer_buffer = ring->transfer_buffer,
+            .offset = first_draw * (Uint32)sizeof(DrawData),
+        };
+
+        SDL_GPUBufferRegion region = {
+            .buffer = ring->buffer,
+            .offset = first_draw * (Uint32)sizeof(DrawData),
+            .size = (Uint32)(sort->count * sizeof(DrawData)),
+        };
+
+        SDL_UploadToGPUBuffer(copy_pass, &location, &region, false);
+
+        renderer->stats.upload_bytes += region.size;
+
+        if (gpu_culling) {
+            gpu_culling_upload_commands(renderer, copy_pass, first_draw);
+        }
+
+        SDL_EndGPUCopyPass(copy_pass);
+    }
+
     SDL_GPUTexture* swapchain_texture;
     Uint32 width, height;
+    Uint64 wait_start = SDL_GetPerformanceCounter();
     SDL_WaitAndAcquireGPUSwapchainTexture(command_buffer, renderer->window, &swapchain_texture, &width, &height);
+    renderer->swapchain_wait_ticks = SDL_GetPerformanceCounter() - wait_start;
 
-    if (!swapchain_texture) {
-        SDL_SubmitGPUCommandBuffer(command_buffer);
+    if (!swapchain_texture || !scene_targets_ensure(renderer, width, height)) {
+        submit_command_buffer(renderer, command_buffer);
         return;
     }
 
+    VertexUniforms vertex_uniforms;
+
+    // Sorting used the recorded camera, only the view is late latched
+    Camera camera = draw_list->camera;
+    renderer->camera_input_ticks = draw_list->input_ticks;
+
+    if (renderer->late_latch && renderer->late_latch(draw_list, &camera, renderer->late_latch_user_data)) {
+        renderer->camera_input_ticks = SDL_GetPerformanceCounter();
+    }
+
+    glm::mat4 view_matrix = glm::lookAt(camera.position, camera.target, glm::vec3(0.0f, 1.0f, 0.0f));
+    vertex_uniforms.proj_view_matrix = renderer->projection_matrix * view_matrix;
+
+    // Culls against the late latched view, before the render pass that draws from its output
+    if (gpu_culling) {
+        gpu_culling_dispatch(renderer, command_buffer, vertex_uniforms.proj_view_matrix, first_draw, (Uint32)sort->count);
+    }
+
+#ifdef ALMOND_DEBUG_DRAW
+    Uint32 debug_vertex_count = debug_lines_upload(renderer, command_buffer, command_count);
+#endif
+
+    // The scene covers a scaled corner of the targets and is stretched over
+    // the swapchain afterwards, at full scale it is drawn to the swapchain directly
+    float scale = renderer->resolution_scaler.scale;
+    Uint32 scene_width = SDL_max((Uint32)((float)width * scale), 1u);
+    Uint32 scene_height = SDL_max((Uint32)((float)height * scale), 1u);
+
+    bool upscale = scene_width != width || scene_height != height;
+    SDL_GPUTexture* scene_target = upscale ? renderer->scene_texture : swapchain_texture;
+
     SDL_FColor clear_color = {
         draw_list->clear_color.r,
         draw_list->clear_color.g,
@@ -384,17 +2718,28 @@ void renderer_play_draw_list(Renderer* renderer, DrawList* draw_list)
         draw_list->clear_color.a,
     };
 
+    if (renderer->overdraw_view) {
+        clear_color = { 0.0f, 0.0f, 0.0f, 1.0f };
+    }
+
     SDL_GPUColorTargetInfo color_target_info = {
-        .texture = renderer->msaa_texture,
+        .texture = scene_target,
         .mip_level = 0,
         .layer_or_depth_plane = 0,
         .clear_color = clear_color,
         .load_op = SDL_GPU_LOADOP_CLEAR,
-        .store_op = SDL_GPU_STOREOP_RESOLVE,
-        .resolve_texture = swapchain_texture,
-        .cycle = true,
+        .store_op = SDL_GPU_STOREOP_STORE,
+        .cycle = upscale,
     };
 
+    if (renderer->msaa_texture) {
+        color_target_info.texture = renderer->msaa_texture;
+        color_target_info.store_op = SDL_GPU_STOREOP_RESOLVE;
+        color_target_info.resolve_texture = scene_target;
+        color_target_info.cycle = true;
+        color_target_info.cycle_resolve_texture = upscale;
+    }
+
     SDL_GPUDepthStencilTargetInfo depth_info = {
         .texture = renderer->depth_texture,
         .clear_depth = 1.0f,
@@ -408,68 +2753,185 @@ void renderer_play_draw_list(Renderer* renderer, DrawList* draw_list)
 
     SDL_GPURenderPass* render_pass = SDL_BeginGPURenderPass(command_buffer, &color_target_info, 1, &depth_info);
 
-    VertexUniforms vertex_uniforms;
+    SDL_GPUViewport viewport = {
+        .x = 0.0f,
+        .y = 0.0f,
+        .w = (float)scene_width,
+        .h = (float)scene_height,
+        .min_depth = 0.0f,
+        .max_depth = 1.0f,
+    };
 
-    glm::mat4 view_matrix = glm::lookAt(draw_list->camera.position, draw_list->camera.target, glm::vec3(0.0f, 1.0f, 0.0f));
-    vertex_uniforms.proj_view_matrix = renderer->projection_matrix * view_matrix;
+    SDL_SetGPUViewport(render_pass, &viewport);
 
-    SDL_BindGPUGraphicsPipeline(render_pass, renderer->graphics_pipeline);
+    RenderState* state = &renderer->render_state;
+    render_state_begin(state, command_buffer, render_pass);
 
-    for (size_t i = 0; i < draw_list->count; i++) {
-        DrawCommand* cmd = &draw_list->commands[i];
+    // All meshes share the pool buffers
+    render_state_bind_index_buffer(state, renderer->mesh_pool.index_buffer, 0, SDL_GPU_INDEXELEMENTSIZE_16BIT);
+    render_state_bind_vertex_storage_buffer(state, 0, gpu_culling ? renderer->culling.culled_buffer : ring->buffer);
+    render_state_bind_vertex_storage_buffer(state, 1, renderer->material_buffer);
+    render_state_push_vertex_uniforms(state, 0, &vertex_uniforms, sizeof(vertex_uniforms));
 
-        switch (cmd->type) {
-        case DrawCommandType::DrawMesh: {
-            MeshHandle mesh_handle = cmd->as.draw_mesh.mesh;
-            TextureHandle texture_handle = cmd->as.draw_mesh.texture;
-            Transform transform = cmd->as.draw_mesh.transform;
+    // Batches are sorted by material pipeline, the alpha tested ones come last
+    size_t opaque_batches = 0;
 
-            vertex_uniforms.model_matrix = glm::mat4(1.0f);
-            vertex_uniforms.model_matrix = glm::translate(vertex_uniforms.model_matrix, transform.position);
-            vertex_uniforms.model_matrix = vertex_uniforms.model_matrix * glm::mat4_cast(transform.rotation);
-            vertex_uniforms.model_matrix = glm::scale(vertex_uniforms.model_matrix, transform.scale);
+    while (opaque_batches < batches->count && batches->batches[opaque_batches].pipeline == MATERIAL_PIPELINE_OPAQUE) {
+        opaque_batches++;
+    }
 
-            if (!mesh_handle.is_valid() || mesh_handle.value > renderer->mesh_storage.count) {
-                log_err("DrawMesh: Invalid MeshHandle");
-                continue;
-            }
+    // Falls back to a single pass if the pre-pass shaders failed to build
+    bool depth_prepass = renderer->depth_prepass && renderer->depth_prepass_pipeline && renderer->scene_equal_pipeline;
 
-            if (!texture_handle.is_valid() || texture_handle.value > renderer->mesh_storage.count) {
-                log_err("DrawMesh: Invalid TextureHandle");
-                continue;
-            }
+    // Alpha tested draws would write depth where they discard, they are left
+    // out and test LESS in the color pass instead
+    if (depth_prepass) {
+        render_state_bind_pipeline(state, pipeline_registry_get(&renderer->pipelines, renderer->depth_prepass_pipeline));
+        render_state_bind_vertex_buffer(state, renderer->mesh_pool.position_buffer, 0);
+        record_batches(renderer, render_pass, 0, opaque_batches, false, gpu_culling);
+    }
 
-            MeshResource* mesh_resource = &renderer->mesh_storage.meshes[mesh_handle.value - 1];
-            TextureResource* texture_resource = &renderer->texture_storage.textures[texture_handle.value - 1];
+    PipelineId color_pipeline = depth_prepass ? renderer->scene_equal_pipeline : renderer->scene_pipeline;
+    bool overdraw_view = renderer->overdraw_view && renderer->overdraw_pipeline && renderer->overdraw_equal_pipeline;
 
-            SDL_GPUBufferBinding vertex_buffer_bindings = {
-                .buffer = mesh_resource->vertex_buffer,
-                .offset = 0,
-            };
+    if (overdraw_view) {
+        color_pipeline = depth_prepass ? renderer->overdraw_equal_pipeline : renderer->overdraw_pipeline;
+    }
 
-            SDL_BindGPUVertexBuffers(render_pass, 0, &vertex_buffer_bindings, 1);
+    render_state_bind_pipeline(state, pipeline_registry_get(&renderer->pipelines, color_pipeline));
+    render_state_bind_vertex_buffer(state, overdraw_view ? renderer->mesh_pool.position_buffer : renderer->mesh_pool.vertex_buffer, 0);
+    record_batches(renderer, render_pass, 0, opaque_batches, !overdraw_view, gpu_culling);
 
-            SDL_GPUBufferBinding index_buffer_bindings = {
-                .buffer = mesh_resource->index_buffer,
-                .offset = 0,
-            };
+    // Drawn without the cutoff if its shader failed to build
+    if (opaque_batches < batches->count) {
+        PipelineId alpha_test_pipeline = renderer->alpha_test_pipeline ? renderer->alpha_test_pipeline : renderer->scene_pipeline;
 
-            SDL_BindGPUIndexBuffer(render_pass, &index_buffer_bindings, SDL_GPU_INDEXELEMENTSIZE_16BIT);
+        if (overdraw_view) {
+            alpha_test_pipeline = renderer->overdraw_pipeline;
+        }
 
-            SDL_PushGPUVertexUniformData(command_buffer, 0, &vertex_uniforms, sizeof(vertex_uniforms));
+        render_state_bind_pipeline(state, pipeline_registry_get(&renderer->pipelines, alpha_test_pipeline));
+        record_batches(renderer, render_pass, opaque_batches, batches->count, !overdraw_view, gpu_culling);
+    }
 
-            SDL_GPUTextureSamplerBinding binding = {
-                .texture = texture_resource->texture,
-                .sampler = renderer->texture_sampler,
-            };
+#ifdef ALMOND_DEBUG_DRAW
+    // Every line of the frame in one draw, tested against the scene depth
+    if (debug_vertex_count > 0) {
+        render_state_bind_pipeline(state, pipeline_registry_get(&renderer->pipelines, renderer->debug_lines_pipeline));
+        render_state_bind_vertex_buffer(state, renderer->debug_lines.buffer, 0);
+        SDL_DrawGPUPrimitives(render_pass, debug_vertex_count, 1, 0, 0);
+        renderer->stats.draw_calls++;
+    }
+#endif
 
-            SDL_BindGPUFragmentSamplers(render_pass, 0, &binding, 1);
+    SDL_EndGPURenderPass(render_pass);
 
-            SDL_DrawGPUIndexedPrimitives(render_pass, mesh_resource->indices_count, 1, 0, 0, 0);
-        } break;
-        }
+    if (upscale) {
+        SDL_GPUBlitInfo blit_info = {
+            .source = {
+                .texture = renderer->scene_texture,
+                .mip_level = 0,
+                .layer_or_depth_plane = 0,
+                .x = 0,
+                .y = 0,
+                .w = scene_width,
+                .h = scene_height,
+            },
+            .destination = {
+                .texture = swapchain_texture,
+                .mip_level = 0,
+                .layer_or_depth_plane = 0,
+                .x = 0,
+                .y = 0,
+                .w = width,
+                .h = height,
+            },
+            .load_op = SDL_GPU_LOADOP_DONT_CARE,
+            .filter = SDL_GPU_FILTER_LINEAR,
+        };
+
+        SDL_BlitGPUTexture(command_buffer, &blit_info);
     }
 
-    SDL_EndGPURenderPass(render_pass);
-    SDL_SubmitGPUCommandBuffer(command_buffer);
+    submit_command_buffer(renderer, command_buffer);
+}
+
+static void render_stats_report(Renderer* renderer, Uint64 now)
+{
+    RenderStatsReport* report = &renderer->stats_report;
+    RenderStats* stats = &renderer->stats;
+    RenderStats* sum = &report->sum;
+
+    sum->draw_calls += stats->draw_calls;
+    sum->instances += stats->instances;
+    sum->triangles += stats->triangles;
+    sum->binds += stats->binds;
+    sum->binds_skipped += stats->binds_skipped;
+    sum->uniform_bytes += stats->uniform_bytes;
+    sum->upload_bytes += stats->upload_bytes;
+    sum->state_changes_unsorted += stats->state_changes_unsorted;
+    sum->state_changes_sorted += stats->state_changes_sorted;
+    sum->record_ms += stats->record_ms;
+    sum->submit_ms += stats->submit_ms;
+    sum->swapchain_wait_ms += stats->swapchain_wait_ms;
+    sum->input_latency_ms += stats->input_latency_ms;
+
+    report->frames++;
+
+    if (now - report->start < SDL_GetPerformanceFrequency()) {
+        return;
+    }
+
+    double frames = (double)report->frames;
+
+    log_info("draws %.0f (%.0f instances, %.0f tris) | binds %.0f (%.0f skipped) | uniforms %.1f KB | uploads %.1f KB | state changes %.0f -> %.0f | record %.2f ms | submit %.2f ms | swapchain wait %.2f ms | input latency %.2f ms",
+        sum->draw_calls / frames, sum->instances / frames, sum->triangles / frames,
+        sum->binds / frames, sum->binds_skipped / frames,
+        sum->uniform_bytes / frames / 1024.0, (double)sum->upload_bytes / frames / 1024.0,
+        sum->state_changes_unsorted / frames, sum->state_changes_sorted / frames,
+        sum->record_ms / frames, sum->submit_ms / frames, sum->swapchain_wait_ms / frames, sum->input_latency_ms / frames);
+
+    report->start = now;
+    report->frames = 0;
+    SDL_zero(report->sum);
+}
+
+void renderer_play_draw_list(Renderer* renderer, DrawList* draw_list)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    renderer->frame_index++;
+    renderer->swapchain_wait_ticks = 0;
+    renderer->submit_ticks = 0;
+    renderer->camera_input_ticks = 0;
+    SDL_zero(renderer->stats);
+    render_state_reset_stats(&renderer->render_state);
+
+    record_draw_list(renderer, draw_list);
+
+    Uint64 now = SDL_GetPerformanceCounter();
+    double ms_per_tick = 1000.0 / (double)SDL_GetPerformanceFrequency();
+
+    RenderStats* stats = &renderer->stats;
+    stats->binds = renderer->render_state.stats.issued;
+    stats->binds_skipped = renderer->render_state.stats.skipped;
+    stats->uniform_bytes = renderer->render_state.stats.uniform_bytes;
+    stats->swapchain_wait_ms = (float)((double)renderer->swapchain_wait_ticks * ms_per_tick);
+    stats->submit_ms = (float)((double)renderer->submit_ticks * ms_per_tick);
+    stats->record_ms = (float)((double)(now - start - renderer->swapchain_wait_ticks - renderer->submit_ticks) * ms_per_tick);
+
+    if (renderer->camera_input_ticks != 0) {
+        stats->input_latency_ms = (float)((double)(now - renderer->camera_input_ticks) * ms_per_tick);
+    }
+
+    draw_list->stats = *stats;
+
+    if (renderer->stats_report.enabled) {
+        render_stats_report(renderer, now);
+    }
+}
+
+void renderer_set_sample_count(Renderer* renderer, SDL_GPUSampleCount sample_count)
+{
+    renderer->requested_sample_count = sample_count;
 }
@@ -1,51 +1,508 @@
 #pragma once
 
+#include "draw_sort.h"
+#include "offset_allocator.h"
+#include "pipeline_registry.h"
 #include "public/almond.h"
+#include "render_state.h"
+#include "resolution_scaler.h"
+#include "slot_map.h"
+#include "upload_queue.h"
+
 #include <SDL3/SDL_gpu.h>
 
+// Frames the CPU may record ahead of the GPU
+#define RENDERER_MAX_FRAMES_IN_FLIGHT 3
+
+// One extra region so the frame being written never aliases one the GPU reads
+#define DRAW_DATA_RING_FRAMES (RENDERER_MAX_FRAMES_IN_FLIGHT + 1)
+
+#define DYNAMIC_MESH_BUFFERS 3
+#define DYNAMIC_MESH_FRESH 0x80000000u
+
+// A mesh the game rewrites. Its host memory is triple buffered: the game
+// writes one buffer, committed holds the latest published one and the
+// renderer reads the third. Commits and latches swap their buffer with
+// committed, DYNAMIC_MESH_FRESH marks one the renderer has not seen yet.
+//
+// Its pool range holds DRAW_DATA_RING_FRAMES regions of max_vertices and
+// max_indices. Each latched commit is uploaded to the next region, so the
+// regions frames in flight draw from are never overwritten.
+typedef struct {
+    Uint32 max_vertices;
+    Uint32 max_indices;
+
+    uint8_t* buffers;
+    Uint32 buffer_size;
+    Uint32 vertices_count[DYNAMIC_MESH_BUFFERS];
+    Uint32 indices_count[DYNAMIC_MESH_BUFFERS];
+
+    Uint32 write_buffer;
+    SDL_AtomicU32 committed;
+    Uint32 read_buffer;
+
+    // Set once the pool range is reserved
+    bool resident;
+    Uint32 vertex_base;
+    Uint32 index_base;
+    Uint32 region;
+
+    // Latched this frame, staged at transfer_offset of the dynamic upload buffer
+    bool upload_pending;
+    Uint32 transfer_offset;
+} DynamicMesh;
+
+// Ranges of the mesh pool buffers, in vertices and indices
 typedef struct {
     MeshHandle handle;
-    SDL_GPUBuffer* vertex_buffer;
-    SDL_GPUBuffer* index_buffer;
-    size_t indices_count;
+    Uint32 vertex_offset;
+    Uint32 vertices_count;
+    Uint32 first_index;
+    Uint32 indices_count;
+
+    // Local space bounding sphere
+    glm::vec3 bounds_center;
+    float bounds_radius;
+
+    // Staging batch the mesh was uploaded in, 0 while still queued. Dynamic
+    // meshes upload in the frame that draws them and only use it as a flag.
+    SDL_AtomicU32 ready_batch;
+
+    // A DynamicMesh*, NULL for meshes created from data. Shared between
+    // threads, only accessed through mesh_dynamic and mesh_set_dynamic.
+    void* dynamic;
 } MeshResource;
 
+#define MESH_STORAGE_CAPACITY (1024 * 10)
+#define TEXTURE_STORAGE_CAPACITY (1024 * 10)
+
+// Resources are indexed by the slot of their handle
 typedef struct {
     MeshResource* meshes;
+    SlotMap slots;
+} MeshStorage;
+
+// Every mesh lives in one shared vertex buffer and one shared index buffer so a
+// frame binds them once and draws select their range through first_index and
+// vertex_offset. position_buffer repeats the positions tightly packed, at the
+// same vertex offsets, for passes that only need depth.
+typedef struct {
+    SDL_GPUBuffer* vertex_buffer;
+    SDL_GPUBuffer* position_buffer;
+    SDL_GPUBuffer* index_buffer;
+    OffsetAllocator vertex_allocator;
+    OffsetAllocator index_allocator;
+} MeshPool;
+
+// Textures sharing format, size and mip layout are packed as layers of one
+// 2D array texture, so draws using any of them share a binding. A new array
+// opens once one reaches TEXTURE_ARRAY_MAX_LAYERS.
+#define TEXTURE_ARRAY_INITIAL_LAYERS 4
+#define TEXTURE_ARRAY_MAX_LAYERS 256
+
+typedef struct {
+    SDL_GPUTexture* texture;
+    TextureFormat format;
+    Uint32 width;
+    Uint32 height;
+    Uint32 mip_count;
+    bool generate_mips;
+
+    Uint32 layer_count;
+    Uint32 layer_capacity;
+
+    // Bit per layer below layer_count that was released and can be reused
+    Uint64 free_layers[TEXTURE_ARRAY_MAX_LAYERS / 64];
+} TextureArray;
+
+typedef struct {
+    TextureArray* arrays;
     size_t count;
     size_t capacity;
-} MeshStorage;
+} TextureArrayPool;
 
+// Where a texture lives: layer of arrays[array_index]. Each texture fills its
+// whole layer, so its uv rect is always (0, 0, 1, 1).
 typedef struct {
     TextureHandle handle;
-    SDL_GPUTexture* texture;
+    Uint32 array_index;
+    Uint32 layer;
+
+    // Staging batch the texture was uploaded in, 0 while still queued
+    SDL_AtomicU32 ready_batch;
 } TextureResource;
 
 typedef struct {
     TextureResource* textures;
+    SlotMap slots;
+} TextureStorage;
+
+#define MATERIAL_STORAGE_CAPACITY (1024 * 10)
+
+// Pipeline group of a material, the most significant state in the sort key.
+// Opaque materials come first so alpha tested ones draw over their depth.
+typedef enum {
+    MATERIAL_PIPELINE_OPAQUE,
+    MATERIAL_PIPELINE_ALPHA_TEST,
+} MaterialPipeline;
+
+// Per-material record read by the vertex shader, laid out to match the std430
+// struct in vert.glsl. Records are indexed by material slot plus one, index 0
+// is the untextured default.
+typedef struct {
+    Uint32 texture_layer;
+    Uint32 flags;
+    float alpha_cutoff;
+    Uint32 padding;
+} MaterialData;
+
+typedef struct {
+    MaterialHandle handle;
+    TextureHandle albedo;
+    MaterialPipeline pipeline;
+
+    // Staging batch the record was uploaded in, 0 while still queued
+    SDL_AtomicU32 ready_batch;
+} MaterialResource;
+
+typedef struct {
+    MaterialResource* materials;
+    SlotMap slots;
+} MaterialStorage;
+
+typedef enum {
+    DEFERRED_RELEASE_MESH,
+    DEFERRED_RELEASE_TEXTURE,
+} DeferredReleaseType;
+
+// GPU memory of a destroyed resource, kept until the frames that may still
+// read it have completed
+typedef struct {
+    DeferredReleaseType type;
+    Uint64 frame;
+
+    union {
+        struct {
+            Uint32 vertex_offset;
+            Uint32 vertices_count;
+            Uint32 first_index;
+            Uint32 indices_count;
+        } mesh;
+        struct {
+            Uint32 array_index;
+            Uint32 layer;
+        } texture;
+    } as;
+} DeferredRelease;
+
+typedef struct {
+    DeferredRelease* releases;
     size_t count;
     size_t capacity;
-} TextureStorage;
+} DeferredReleaseQueue;
+
+typedef enum {
+    PENDING_UPLOAD_BUFFER,
+    PENDING_UPLOAD_TEXTURE,
+} PendingUploadType;
+
+typedef struct {
+    PendingUploadType type;
+    // The ring, or a dedicated buffer for an upload larger than the ring
+    SDL_GPUTransferBuffer* transfer_buffer;
+    Uint32 staging_offset;
+    Uint32 size;
+
+    SDL_GPUBuffer* buffer;
+    Uint32 buffer_offset;
+
+    SDL_GPUTexture* texture;
+    Uint32 mip_level;
+    Uint32 layer;
+    Uint32 width;
+    Uint32 height;
+    // Fill the remaining levels from this one once the copy pass is done
+    bool generate_mips;
+} PendingUpload;
+
+typedef struct {
+    SDL_GPUFence* fence;
+    Uint32 batch;
+    Uint32 begin;
+    Uint32 end;
+} StagingSubmission;
+
+#define STAGING_MAX_PENDING_UPLOADS 1024
+#define STAGING_MAX_SUBMISSIONS 32
+#define STAGING_MAX_DEDICATED_BUFFERS 16
+
+// Persistent upload buffer shared by every resource creation. Uploads are
+// written at the head of the ring and recorded as pending copies, then flushed
+// together in a single copy pass. Regions still read by the GPU are tracked
+// with fences so the head never overwrites them. Every flush is numbered; once
+// its fence signals, completed_batch tells which resources can be drawn.
+//
+// An upload larger than the whole ring gets a transfer buffer of its own,
+// released once the flush that copies from it is submitted.
+typedef struct {
+    SDL_GPUTransferBuffer* transfer_buffer;
+    uint8_t* mapped;
+    Uint32 size;
+    Uint32 head;
+    Uint32 batch_begin;
+
+    // Buffer of the last allocation, pending uploads copy from it
+    SDL_GPUTransferBuffer* alloc_buffer;
+
+    SDL_GPUTransferBuffer* dedicated[STAGING_MAX_DEDICATED_BUFFERS];
+    size_t dedicated_count;
+    SDL_GPUTransferBuffer* dedicated_mapped;
+
+    Uint32 batch;
+    SDL_AtomicU32 completed_batch;
+
+    PendingUpload pending[STAGING_MAX_PENDING_UPLOADS];
+    size_t pending_count;
+
+    StagingSubmission submissions[STAGING_MAX_SUBMISSIONS];
+    size_t submissions_count;
+} StagingRing;
+
+// Consecutive sorted draws sharing material pipeline, mesh and texture array,
+// drawn with one instanced call
+typedef struct {
+    MaterialPipeline pipeline;
+    MeshResource* mesh;
+    SDL_GPUTexture* texture_array;
+    Uint32 first_instance;
+    Uint32 instance_count;
+} DrawBatch;
+
+typedef struct {
+    DrawBatch* batches;
+    size_t count;
+    size_t capacity;
+} DrawBatchList;
+
+// Commands of the draw list being played, gathered from its pages so sorted
+// draws can be looked up by index
+typedef struct {
+    const DrawCommandHeader** commands;
+    size_t capacity;
+} DrawCommandTable;
+
+// Per-draw record read by the vertex shader through gl_InstanceIndex,
+// laid out to match the std430 struct in vert.glsl. The mesh slot and batch
+// are only read by cull_comp.glsl.
+typedef struct {
+    glm::mat4 model_matrix;
+    Uint32 material_index;
+    Uint32 mesh_index;
+    Uint32 batch_index;
+    Uint32 padding;
+} DrawData;
+
+// Storage buffer split into one region per frame in flight. Each frame writes
+// all of its DrawData into the next region with a single transfer, and draws
+// address it through first_instance.
+typedef struct {
+    SDL_GPUBuffer* buffer;
+    SDL_GPUTransferBuffer* transfer_buffer;
+    Uint32 capacity; // DrawData per region
+    Uint32 frame;
+
+    // Transform of each draw, gathered for the batched matrix conversion
+    const Transform** transforms;
+} DrawDataRing;
+
+// GPU culling: a compute pass tests every draw's bounding sphere against the
+// frustum, copies the DrawData of visible draws into culled_buffer and counts
+// them into one indirect command per batch, which the render passes draw from.
+typedef struct {
+    // NULL when cull_comp.spv could not be loaded, draws are then submitted unculled
+    SDL_GPUComputePipeline* pipeline;
+
+    // Local bounding sphere per mesh slot, written when the mesh uploads
+    SDL_GPUBuffer* mesh_bounds_buffer;
+
+    // Sized like one DrawDataRing region
+    SDL_GPUBuffer* culled_buffer;
+    SDL_GPUBuffer* indirect_buffer;
+    SDL_GPUTransferBuffer* indirect_transfer_buffer;
+    Uint32 capacity;
+} GpuCulling;
+
+// Handles of the resident dynamic meshes, checked for new commits every
+// frame. Latched contents are staged in transfer_buffer, cycled each frame.
+typedef struct {
+    Uint32* handles;
+    size_t count;
+    size_t capacity;
+
+    SDL_GPUTransferBuffer* transfer_buffer;
+    Uint32 transfer_capacity; // Bytes
+} DynamicMeshList;
+
+#ifdef ALMOND_DEBUG_DRAW
+// The DebugLines commands of a frame, gathered into one vertex buffer and
+// drawn as a single line list after the scene
+typedef struct {
+    SDL_GPUBuffer* buffer;
+    SDL_GPUTransferBuffer* transfer_buffer;
+    Uint32 capacity; // Vertices
+} DebugLineBuffer;
+#endif
+
+// Stats summed over the frames since the last report, logged as averages
+// once per second when enabled
+typedef struct {
+    bool enabled;
+    Uint64 start;
+    Uint32 frames;
+    RenderStats sum;
+} RenderStatsReport;
+
+// Lets the platform replace the camera of a draw list with one updated from
+// input that arrived while the renderer waited for the swapchain. Returns
+// false to keep the recorded camera.
+typedef bool RendererLateLatchFn(const DrawList* draw_list, Camera* out_camera, void* user_data);
+
+typedef struct {
+    SDL_GPUPresentMode present_mode;
+    Uint32 frames_in_flight;
+    SDL_GPUSampleCount sample_count;
+    // Frame time the resolution scale is adjusted to hold, 0 keeps full resolution
+    float frame_budget_ms;
+    // Log the render stats averaged over every second
+    bool log_stats;
+    // Lay down depth with a position only pass so the color pass shades each
+    // sample once
+    bool depth_prepass;
+    // Cull on the GPU and draw through indirect commands
+    bool gpu_culling;
+} RendererConfig;
 
 typedef struct {
     SDL_GPUDevice* device;
     SDL_Window* window;
 
+    SDL_GPUPresentMode present_mode;
+    Uint32 frames_in_flight;
+
+    // Frames played so far
+    Uint64 frame_index;
+
+    // Performance counter ticks the last frame spent acquiring the swapchain
+    // and submitting its command buffers
+    Uint64 swapchain_wait_ticks;
+    Uint64 submit_ticks;
+
+    // Called after the swapchain is acquired, NULL disables late latching
+    RendererLateLatchFn* late_latch;
+    void* late_latch_user_data;
+    // Time of the input the last frame's camera was built from
+    Uint64 camera_input_ticks;
+
+    // Targets are sized to the swapchain and recreated lazily when it resizes
+    // or the sample count changes. msaa_texture is NULL without MSAA.
     SDL_GPUTexture* depth_texture;
     SDL_GPUTexture* msaa_texture;
+    SDL_GPUTexture* scene_texture;
+    Uint32 target_width;
+    Uint32 target_height;
+    SDL_GPUSampleCount sample_count;
+    SDL_GPUSampleCount requested_sample_count;
 
-    SDL_GPUGraphicsPipeline* graphics_pipeline;
-    SDL_GPUGraphicsPipeline* debug_collider_pipeline;
+    ResolutionScaler resolution_scaler;
 
+    PipelineRegistry pipelines;
+    PipelineId scene_pipeline;
+    PipelineId alpha_test_pipeline;
+    PipelineId depth_prepass_pipeline;
+    PipelineId scene_equal_pipeline;
+    PipelineId overdraw_pipeline;
+    PipelineId overdraw_equal_pipeline;
+
+    // All three can be flipped between frames
+    bool depth_prepass;
+    bool gpu_culling;
+    // Replaces shading with additive blending, brighter means more fragments
+    // shaded per pixel
+    bool overdraw_view;
+
+    MeshPool mesh_pool;
     MeshStorage mesh_storage;
     TextureStorage texture_storage;
+    MaterialStorage material_storage;
+    TextureArrayPool texture_arrays;
+    DeferredReleaseQueue deferred_releases;
+    DynamicMeshList dynamic_meshes;
 
     SDL_GPUSampler* texture_sampler;
+    // Single layer array bound in place of textures still being uploaded.
+    // Array layers are clamped when sampled, so any material samples its
+    // one texel.
+    SDL_GPUTexture* fallback_texture;
+
+    // MaterialData of every material slot, after the default record
+    SDL_GPUBuffer* material_buffer;
+
+    StagingRing staging;
+    UploadQueue upload_queue;
+
+    DrawCommandTable draw_commands;
+    DrawSortBuffers draw_sort;
+
+    DrawBatchList draw_batches;
+    DrawDataRing draw_data;
+    GpuCulling culling;
+
+#ifdef ALMOND_DEBUG_DRAW
+    PipelineId debug_lines_pipeline;
+    DebugLineBuffer debug_lines;
+#endif
+
+    RenderState render_state;
+
+    // Stats of the frame being played, copied to its draw list at the end
+    RenderStats stats;
+    RenderStatsReport stats_report;
 
     glm::mat4 projection_matrix;
 } Renderer;
 
-bool renderer_init(Renderer* renderer, SDL_Window* window);
+// Unsupported present modes fall back towards VSYNC, which is always available.
+// frames_in_flight is clamped to [1, RENDERER_MAX_FRAMES_IN_FLIGHT].
+bool renderer_init(Renderer* renderer, SDL_Window* window, const RendererConfig* config);
+
+// Waits for the GPU and destroys the device, called before the window goes away
+void renderer_shutdown(Renderer* renderer);
+
+// Resource creation and destruction are thread-safe: handles are returned
+// immediately and the data is uploaded the next time the renderer drains its
+// upload queue. Destroyed handles are stale right away, their GPU memory is
+// reused once no frame in flight can still read it. A handle whose upload
+// fails turns stale the same way, so it never reads as still uploading.
 MeshHandle renderer_create_mesh(Renderer* renderer, MeshData* mesh_data);
+void renderer_create_meshes(Renderer* renderer, MeshData* mesh_datas, size_t count, MeshHandle* out_handles);
 TextureHandle renderer_create_texture(Renderer* renderer, const uint8_t* rgba_data, uint32_t width, uint32_t height);
+TextureHandle renderer_create_texture_from_data(Renderer* renderer, const TextureData* texture_data);
+bool renderer_is_texture_format_supported(Renderer* renderer, TextureFormat format);
+void renderer_destroy_mesh(Renderer* renderer, MeshHandle handle);
+void renderer_destroy_texture(Renderer* renderer, TextureHandle handle);
+bool renderer_is_mesh_ready(Renderer* renderer, MeshHandle handle);
+bool renderer_is_texture_ready(Renderer* renderer, TextureHandle handle);
+MaterialHandle renderer_create_material(Renderer* renderer, TextureHandle albedo, MaterialFlags flags);
+bool renderer_is_material_ready(Renderer* renderer, MaterialHandle handle);
+
+// Host memory is allocated on the calling thread, the pool ranges with the
+// next upload drain
+MeshHandle renderer_create_dynamic_mesh(Renderer* renderer, Uint32 max_vertices, Uint32 max_indices);
+bool renderer_map_dynamic_mesh(Renderer* renderer, MeshHandle handle, MeshData* out_mesh_data);
+void renderer_commit_dynamic_mesh(Renderer* renderer, MeshHandle handle, Uint32 vertices_count, Uint32 indices_count);
+
+// Records and submits the frame, then fills draw_list->stats
 void renderer_play_draw_list(Renderer* renderer, DrawList* draw_list);
+
+// Takes effect on the next played frame, unsupported counts disable MSAA
+void renderer_set_sample_count(Renderer* renderer, SDL_GPUSampleCount sample_count);
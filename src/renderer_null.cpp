@@ -0,0 +1,294 @@
+#include "renderer_null.h"
+
+#include "logger.h"
+
+#include <SDL3/SDL_timer.h>
+
+static void add_upload_bytes(NullRenderer* renderer, Uint64 size)
+{
+    SDL_LockSpinlock(&renderer->upload_lock);
+    renderer->upload_bytes += size;
+    SDL_UnlockSpinlock(&renderer->upload_lock);
+}
+
+bool null_renderer_init(NullRenderer* renderer)
+{
+    SDL_zerop(renderer);
+
+    renderer->meshes = (NullMesh*)SDL_calloc(NULL_RENDERER_MAX_MESHES, sizeof(NullMesh));
+
+    if (!renderer->meshes
+        || !slot_map_init(&renderer->mesh_slots, NULL_RENDERER_MAX_MESHES)
+        || !slot_map_init(&renderer->texture_slots, NULL_RENDERER_MAX_TEXTURES)
+        || !slot_map_init(&renderer->material_slots, NULL_RENDERER_MAX_MATERIALS)) {
+        log_err("Could not create resource storage");
+        return false;
+    }
+
+    log_info("Using the null renderer");
+
+    return true;
+}
+
+MeshHandle null_renderer_create_mesh(NullRenderer* renderer, MeshData* mesh_data)
+{
+    if (mesh_data->vertices_count == 0 || mesh_data->indices_count == 0) {
+        log_err("Mesh has no vertices or indices");
+        return MeshHandle::invalid();
+    }
+
+    Uint32 handle = slot_map_alloc(&renderer->mesh_slots);
+    if (!handle) {
+        log_err("Mesh storage full");
+        return MeshHandle::invalid();
+    }
+
+    NullMesh* mesh = &renderer->meshes[slot_map_index(handle)];
+    mesh->indices_count = (Uint32)mesh_data->indices_count;
+    mesh->dynamic_data = NULL;
+
+    add_upload_bytes(renderer, mesh_data->vertices_count * sizeof(Vertex) + mesh_data->indices_count * sizeof(uint16_t));
+
+    return MeshHandle(handle);
+}
+
+void null_renderer_create_meshes(NullRenderer* renderer, MeshData* mesh_datas, size_t count, MeshHandle* out_handles)
+{
+    for (size_t i = 0; i < count; i++) {
+        out_handles[i] = null_renderer_create_mesh(renderer, &mesh_datas[i]);
+    }
+}
+
+TextureHandle null_renderer_create_texture(NullRenderer* renderer, const uint8_t* rgba_data, uint32_t width, uint32_t height)
+{
+    TextureData texture_data = {
+        .format = TextureFormat::RGBA8,
+        .width = width,
+        .height = height,
+        .mip_count = 0,
+        .data = rgba_data,
+        .size = texture_level_size(TextureFormat::RGBA8, width, height),
+    };
+
+    return null_renderer_create_texture_from_data(renderer, &texture_data);
+}
+
+TextureHandle null_renderer_create_texture_from_data(NullRenderer* renderer, const TextureData* texture_data)
+{
+    if (texture_data->width == 0 || texture_data->height == 0) {
+        log_err("Texture has no size");
+        return TextureHandle::invalid();
+    }
+
+    Uint32 handle = slot_map_alloc(&renderer->texture_slots);
+    if (!handle) {
+        log_err("Texture storage full");
+        return TextureHandle::invalid();
+    }
+
+    add_upload_bytes(renderer, texture_data->size);
+
+    return TextureHandle(handle);
+}
+
+bool null_renderer_is_texture_format_supported(NullRenderer*, TextureFormat)
+{
+    // Reported like a desktop GPU so the game takes the same loading path
+    return true;
+}
+
+void null_renderer_destroy_mesh(NullRenderer* renderer, MeshHandle handle)
+{
+    // Nothing can still be reading the mesh, the slot is reused right away
+    if (!slot_map_retire(&renderer->mesh_slots, handle.value)) {
+        log_warn("Destroying a stale mesh handle");
+        return;
+    }
+
+    NullMesh* mesh = &renderer->meshes[slot_map_index(handle.value)];
+    SDL_free(mesh->dynamic_data);
+    mesh->dynamic_data = NULL;
+
+    slot_map_release(&renderer->mesh_slots, handle.value);
+}
+
+void null_renderer_destroy_texture(NullRenderer* renderer, TextureHandle handle)
+{
+    if (!slot_map_retire(&renderer->texture_slots, handle.value)) {
+        log_warn("Destroying a stale texture handle");
+        return;
+    }
+
+    slot_map_release(&renderer->texture_slots, handle.value);
+}
+
+bool null_renderer_is_mesh_ready(NullRenderer* renderer, MeshHandle handle)
+{
+    return slot_map_is_live(&renderer->mesh_slots, handle.value);
+}
+
+bool null_renderer_is_texture_ready(NullRenderer* renderer, TextureHandle handle)
+{
+    return slot_map_is_live(&renderer->texture_slots, handle.value);
+}
+
+MeshHandle null_renderer_create_dynamic_mesh(NullRenderer* renderer, Uint32 max_vertices, Uint32 max_indices)
+{
+    if (max_vertices == 0 || max_indices == 0) {
+        log_err("Mesh has no vertices or indices");
+        return MeshHandle::invalid();
+    }
+
+    Uint32 handle = slot_map_alloc(&renderer->mesh_slots);
+    if (!handle) {
+        log_err("Mesh storage full");
+        return MeshHandle::invalid();
+    }
+
+    NullMesh* mesh = &renderer->meshes[slot_map_index(handle)];
+    mesh->dynamic_data = (uint8_t*)SDL_malloc(max_vertices * sizeof(Vertex) + max_indices * sizeof(uint16_t));
+
+    if (!mesh->dynamic_data) {
+        log_err("Out of memory");
+        slot_map_retire(&renderer->mesh_slots, handle);
+        slot_map_release(&renderer->mesh_slots, handle);
+        return MeshHandle::invalid();
+    }
+
+    mesh->indices_count = 0;
+    mesh->max_vertices = max_vertices;
+    mesh->max_indices = max_indices;
+
+    return MeshHandle(handle);
+}
+
+bool null_renderer_map_dynamic_mesh(NullRenderer* renderer, MeshHandle handle, MeshData* out_mesh_data)
+{
+    if (!slot_map_is_live(&renderer->mesh_slots, handle.value)) {
+        log_warn("Using a stale mesh handle");
+        return false;
+    }
+
+    NullMesh* mesh = &renderer->meshes[slot_map_index(handle.value)];
+    if (!mesh->dynamic_data) {
+        log_err("Mesh is not dynamic");
+        return false;
+    }
+
+    out_mesh_data->vertices = (Vertex*)mesh->dynamic_data;
+    out_mesh_data->vertices_count = mesh->max_vertices;
+    out_mesh_data->indices = (uint16_t*)(mesh->dynamic_data + mesh->max_vertices * sizeof(Vertex));
+    out_mesh_data->indices_count = mesh->max_indices;
+
+    return true;
+}
+
+void null_renderer_commit_dynamic_mesh(NullRenderer* renderer, MeshHandle handle, Uint32 vertices_count, Uint32 indices_count)
+{
+    if (!slot_map_is_live(&renderer->mesh_slots, handle.value)) {
+        log_warn("Using a stale mesh handle");
+        return;
+    }
+
+    NullMesh* mesh = &renderer->meshes[slot_map_index(handle.value)];
+    if (!mesh->dynamic_data) {
+        log_err("Mesh is not dynamic");
+        return;
+    }
+
+    // Counted like the GPU renderer, which uploads every commit it latches
+    vertices_count = SDL_min(vertices_count, mesh->max_vertices);
+    indices_count = SDL_min(indices_count, mesh->max_indices);
+
+    mesh->indices_count = indices_count;
+
+    add_upload_bytes(renderer, vertices_count * (sizeof(Vertex) + sizeof(glm::vec3)) + indices_count * sizeof(uint16_t));
+}
+
+MaterialHandle null_renderer_create_material(NullRenderer* renderer, TextureHandle, MaterialFlags)
+{
+    Uint32 handle = slot_map_alloc(&renderer->material_slots);
+    if (!handle) {
+        log_err("Material storage full");
+        return MaterialHandle::invalid();
+    }
+
+    // Same size as the record the GPU renderer uploads
+    add_upload_bytes(renderer, sizeof(Uint32) * 4);
+
+    return MaterialHandle(handle);
+}
+
+void null_renderer_play_draw_list(NullRenderer* renderer, DrawList* draw_list)
+{
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    RenderStats stats = {};
+
+    SDL_LockSpinlock(&renderer->upload_lock);
+    stats.upload_bytes = renderer->upload_bytes;
+    renderer->upload_bytes = 0;
+    SDL_UnlockSpinlock(&renderer->upload_lock);
+
+    Uint32 invalid_draws = 0;
+
+    DrawListIterator it = draw_list_begin(draw_list);
+
+    while (const DrawCommandHeader* header = draw_list_next(draw_list, &it)) {
+        MeshHandle mesh_handle;
+        MaterialHandle material_handle;
+
+        switch (header->type) {
+        case DrawCommandType::DrawMesh: {
+            mesh_handle = draw_command_payload<DrawMeshCommand>(header)->mesh;
+            material_handle = draw_command_payload<DrawMeshCommand>(header)->material;
+        } break;
+        case DrawCommandType::DrawMeshMatrix: {
+            mesh_handle = draw_command_payload<DrawMeshMatrixCommand>(header)->mesh;
+            material_handle = draw_command_payload<DrawMeshMatrixCommand>(header)->material;
+        } break;
+        default:
+            continue;
+        }
+
+        // An invalid material handle means the default, a stale one is a bug
+        if (!null_renderer_is_mesh_ready(renderer, mesh_handle)
+            || (material_handle.is_valid() && !slot_map_is_live(&renderer->material_slots, material_handle.value))) {
+            invalid_draws++;
+            continue;
+        }
+
+        // Counted like the GPU renderer before batching, one call per draw
+        stats.draw_calls++;
+        stats.instances++;
+        stats.triangles += renderer->meshes[slot_map_index(mesh_handle.value)].indices_count / 3;
+    }
+
+    stats.record_ms = (float)((double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)SDL_GetPerformanceFrequency());
+
+    draw_list->stats = stats;
+
+    renderer->frames++;
+    renderer->draws += stats.draw_calls;
+    renderer->triangles += stats.triangles;
+    renderer->invalid_draws += invalid_draws;
+    renderer->uploaded_bytes += stats.upload_bytes;
+    renderer->record_ms += stats.record_ms;
+}
+
+void null_renderer_report(NullRenderer* renderer)
+{
+    if (renderer->frames == 0) {
+        return;
+    }
+
+    double frames = (double)renderer->frames;
+
+    log_info("%llu frames | draws %.0f/frame | tris %.0f/frame | invalid draws %llu | uploaded %.1f MB | record %.3f ms/frame",
+        (unsigned long long)renderer->frames,
+        (double)renderer->draws / frames,
+        (double)renderer->triangles / frames,
+        (unsigned long long)renderer->invalid_draws,
+        (double)renderer->uploaded_bytes / (1024.0 * 1024.0),
+        renderer->record_ms / frames);
+}
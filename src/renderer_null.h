@@ -0,0 +1,67 @@
+#pragma once
+
+#include "public/almond.h"
+#include "slot_map.h"
+
+#include <SDL3/SDL_atomic.h>
+
+#define NULL_RENDERER_MAX_MESHES (1024 * 10)
+#define NULL_RENDERER_MAX_TEXTURES (1024 * 10)
+#define NULL_RENDERER_MAX_MATERIALS (1024 * 10)
+
+typedef struct {
+    Uint32 indices_count;
+
+    // Memory the game maps, dynamic meshes only. Nothing reads it, so one
+    // buffer is enough.
+    uint8_t* dynamic_data;
+    Uint32 max_vertices;
+    Uint32 max_indices;
+} NullMesh;
+
+// Stands in for Renderer where there is no GPU. Resources only get a handle
+// and what is needed to count their work, playing a draw list validates its
+// handles and fills the same stats the GPU renderer reports.
+typedef struct {
+    NullMesh* meshes;
+    SlotMap mesh_slots;
+    SlotMap texture_slots;
+    SlotMap material_slots;
+
+    // Bytes created since the last played frame, resources may be created
+    // from any thread
+    SDL_SpinLock upload_lock;
+    Uint64 upload_bytes;
+
+    // Totals over every played frame
+    Uint64 frames;
+    Uint64 draws;
+    Uint64 triangles;
+    Uint64 invalid_draws;
+    Uint64 uploaded_bytes;
+    double record_ms;
+} NullRenderer;
+
+bool null_renderer_init(NullRenderer* renderer);
+
+// Same contract as the renderer_* functions, resources are ready as soon as
+// they are created
+MeshHandle null_renderer_create_mesh(NullRenderer* renderer, MeshData* mesh_data);
+void null_renderer_create_meshes(NullRenderer* renderer, MeshData* mesh_datas, size_t count, MeshHandle* out_handles);
+TextureHandle null_renderer_create_texture(NullRenderer* renderer, const uint8_t* rgba_data, uint32_t width, uint32_t height);
+TextureHandle null_renderer_create_texture_from_data(NullRenderer* renderer, const TextureData* texture_data);
+bool null_renderer_is_texture_format_supported(NullRenderer* renderer, TextureFormat format);
+void null_renderer_destroy_mesh(NullRenderer* renderer, MeshHandle handle);
+void null_renderer_destroy_texture(NullRenderer* renderer, TextureHandle handle);
+bool null_renderer_is_mesh_ready(NullRenderer* renderer, MeshHandle handle);
+bool null_renderer_is_texture_ready(NullRenderer* renderer, TextureHandle handle);
+MeshHandle null_renderer_create_dynamic_mesh(NullRenderer* renderer, Uint32 max_vertices, Uint32 max_indices);
+bool null_renderer_map_dynamic_mesh(NullRenderer* renderer, MeshHandle handle, MeshData* out_mesh_data);
+void null_renderer_commit_dynamic_mesh(NullRenderer* renderer, MeshHandle handle, Uint32 vertices_count, Uint32 indices_count);
+MaterialHandle null_renderer_create_material(NullRenderer* renderer, TextureHandle albedo, MaterialFlags flags);
+
+// Draws referencing stale or unknown handles are skipped and counted as invalid
+void null_renderer_play_draw_list(NullRenderer* renderer, DrawList* draw_list);
+
+// Logs the totals over every played frame
+void null_renderer_report(NullRenderer* renderer);
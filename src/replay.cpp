@@ -0,0 +1,372 @@
+#include "capture.h"
+#include "logger.h"
+#include "public/almond.h"
+#include "renderer.h"
+
+#include <SDL3/SDL.h>
+#include <cstdio>
+#include <cstdlib>
+
+// Replays a trace recorded with almond --capture through the renderer as fast
+// as the present mode allows and prints the timings of every frame as CSV.
+
+Renderer renderer;
+
+// Recorded handles are remapped to the ones this run creates, by slot. The
+// recorded value is kept too so stale handles in the trace stay stale.
+typedef struct {
+    Uint32* recorded;
+    Uint32* replayed;
+} HandleMap;
+
+static bool handle_map_init(HandleMap* map)
+{
+    map->recorded = (Uint32*)SDL_calloc(SLOT_MAP_MAX_SLOTS, sizeof(Uint32));
+    map->replayed = (Uint32*)SDL_calloc(SLOT_MAP_MAX_SLOTS, sizeof(Uint32));
+
+    return map->recorded && map->replayed;
+}
+
+static void handle_map_set(HandleMap* map, Uint32 recorded, Uint32 replayed)
+{
+    if (recorded == 0) {
+        return;
+    }
+
+    map->recorded[slot_map_index(recorded)] = recorded;
+    map->replayed[slot_map_index(recorded)] = replayed;
+}
+
+static Uint32 handle_map_get(HandleMap* map, Uint32 recorded)
+{
+    if (recorded == 0 || map->recorded[slot_map_index(recorded)] != recorded) {
+        return 0;
+    }
+
+    return map->replayed[slot_map_index(recorded)];
+}
+
+static ALLOCATE_DRAW_LIST_PAGE(allocate_draw_list_page)
+{
+    auto* page = (DrawListPage*)SDL_malloc(sizeof(DrawListPage) + min_capacity);
+    if (!page) {
+        return NULL;
+    }
+
+    page->capacity = min_capacity;
+
+    return page;
+}
+
+typedef struct {
+    HandleMap meshes;
+    HandleMap textures;
+    HandleMap materials;
+    DrawList draw_list;
+} Replay;
+
+static void replay_resource(Replay* replay, CaptureRecordType type, const uint8_t* payload, Uint32 size)
+{
+    switch (type) {
+    case CAPTURE_RECORD_MESH: {
+        CaptureMesh mesh;
+        SDL_memcpy(&mesh, payload, sizeof(mesh));
+
+        MeshData mesh_data = {
+            .vertices = (Vertex*)(payload + sizeof(mesh)),
+            .vertices_count = mesh.vertices_count,
+            .indices = (uint16_t*)(payload + sizeof(mesh) + mesh.vertices_count * sizeof(Vertex)),
+            .indices_count = mesh.indices_count,
+        };
+
+        MeshHandle handle = renderer_create_mesh(&renderer, &mesh_data);
+        handle_map_set(&replay->meshes, mesh.handle, handle.value);
+    } break;
+    case CAPTURE_RECORD_TEXTURE: {
+        CaptureTexture texture;
+        SDL_memcpy(&texture, payload, sizeof(texture));
+
+        const uint8_t* data = payload + sizeof(texture);
+        TextureHandle handle;
+
+        if (texture.mip_count == 0) {
+            handle = renderer_create_texture(&renderer, data, texture.width, texture.height);
+        } else {
+            TextureData texture_data = {
+                .format = (TextureFormat)texture.format,
+                .width = texture.width,
+                .height = texture.height,
+                .mip_count = texture.mip_count,
+                .data = data,
+                .size = size - sizeof(texture),
+            };
+
+            handle = renderer_create_texture_from_data(&renderer, &texture_data);
+        }
+
+        handle_map_set(&replay->textures, texture.handle, handle.value);
+    } break;
+    case CAPTURE_RECORD_MATERIAL: {
+        CaptureMaterial material;
+        SDL_memcpy(&material, payload, sizeof(material));
+
+        TextureHandle albedo = TextureHandle(handle_map_get(&replay->textures, material.albedo));
+        MaterialHandle handle = renderer_create_material(&renderer, albedo, (MaterialFlags)material.flags);
+        handle_map_set(&replay->materials, material.handle, handle.value);
+    } break;
+    case CAPTURE_RECORD_DESTROY_MESH: {
+        CaptureDestroy destroy;
+        SDL_memcpy(&destroy, payload, sizeof(destroy));
+        renderer_destroy_mesh(&renderer, MeshHandle(handle_map_get(&replay->meshes, destroy.handle)));
+    } break;
+    case CAPTURE_RECORD_DESTROY_TEXTURE: {
+        CaptureDestroy destroy;
+        SDL_memcpy(&destroy, payload, sizeof(destroy));
+        renderer_destroy_texture(&renderer, TextureHandle(handle_map_get(&replay->textures, destroy.handle)));
+    } break;
+    default:
+        break;
+    }
+}
+
+// Rebuilds the recorded draw list with the handles of this run
+static void replay_build_draw_list(Replay* replay, const uint8_t* payload, Uint32 size)
+{
+    CaptureFrame frame;
+    SDL_memcpy(&frame, payload, sizeof(frame));
+
+    DrawList* draw_list = &replay->draw_list;
+    draw_list_reset(draw_list);
+    draw_list->clear_color = frame.clear_color;
+    draw_list->camera = frame.camera;
+
+    const uint8_t* stream = payload + sizeof(frame);
+    const uint8_t* end = payload + size;
+
+    while (stream + sizeof(DrawCommandHeader) <= end) {
+        DrawCommandHeader header;
+        SDL_memcpy(&header, stream, sizeof(header));
+
+        if (header.size < sizeof(header) || stream + header.size > end) {
+            log_warn("Corrupt command in frame");
+            break;
+        }
+
+        void* command = draw_list_push(draw_list, header.type, header.size - sizeof(header));
+        if (!command) {
+            log_err("Out of draw list memory");
+            break;
+        }
+
+        SDL_memcpy(command, stream + sizeof(header), header.size - sizeof(header));
+
+        switch (header.type) {
+        case DrawCommandType::DrawMesh: {
+            auto* cmd = (DrawMeshCommand*)command;
+            cmd->mesh = MeshHandle(handle_map_get(&replay->meshes, cmd->mesh.value));
+            cmd->material = MaterialHandle(handle_map_get(&replay->materials, cmd->material.value));
+        } break;
+        case DrawCommandType::DrawMeshMatrix: {
+            auto* cmd = (DrawMeshMatrixCommand*)command;
+            cmd->mesh = MeshHandle(handle_map_get(&replay->meshes, cmd->mesh.value));
+            cmd->material = MaterialHandle(handle_map_get(&replay->materials, cmd->material.value));
+        } break;
+        default:
+            break;
+        }
+
+        stream += header.size;
+    }
+}
+
+typedef struct {
+    const char* capture_path;
+    RendererConfig renderer_config;
+    // Only the first loop creates and destroys resources, later ones replay
+    // the draw lists alone
+    Uint32 loops;
+} ReplayOptions;
+
+static void print_usage_and_exit()
+{
+    fprintf(stderr, "Usage: almond_replay [--present-mode vsync|mailbox|immediate] [--frames-in-flight N] [--msaa 1|2|4|8] [--loops N] [--depth-prepass] [--gpu-culling] trace.acap\n");
+    exit(1);
+}
+
+static ReplayOptions parse_options(int argc, char* argv[])
+{
+    ReplayOptions options = {};
+    options.renderer_config.present_mode = SDL_GPU_PRESENTMODE_IMMEDIATE;
+    options.renderer_config.frames_in_flight = 2;
+    options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_4;
+    options.loops = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (strcmp(arg, "--present-mode") == 0 && has_value) {
+            const char* mode = argv[++i];
+
+            if (strcmp(mode, "vsync") == 0) {
+                options.renderer_config.present_mode = SDL_GPU_PRESENTMODE_VSYNC;
+            } else if (strcmp(mode, "mailbox") == 0) {
+                options.renderer_config.present_mode = SDL_GPU_PRESENTMODE_MAILBOX;
+            } else if (strcmp(mode, "immediate") == 0) {
+                options.renderer_config.present_mode = SDL_GPU_PRESENTMODE_IMMEDIATE;
+            } else {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(arg, "--frames-in-flight") == 0 && has_value) {
+            options.renderer_config.frames_in_flight = (Uint32)atoi(argv[++i]);
+        } else if (strcmp(arg, "--msaa") == 0 && has_value) {
+            int samples = atoi(argv[++i]);
+
+            if (samples == 1) {
+                options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_1;
+            } else if (samples == 2) {
+                options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_2;
+            } else if (samples == 4) {
+                options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_4;
+            } else if (samples == 8) {
+                options.renderer_config.sample_count = SDL_GPU_SAMPLECOUNT_8;
+            } else {
+                print_usage_and_exit();
+            }
+        } else if (strcmp(arg, "--depth-prepass") == 0) {
+            options.renderer_config.depth_prepass = true;
+        } else if (strcmp(arg, "--gpu-culling") == 0) {
+            options.renderer_config.gpu_culling = true;
+        } else if (strcmp(arg, "--loops") == 0 && has_value) {
+            options.loops = (Uint32)SDL_max(atoi(argv[++i]), 1);
+        } else if (arg[0] != '-' && !options.capture_path) {
+            options.capture_path = arg;
+        } else {
+            print_usage_and_exit();
+        }
+    }
+
+    if (!options.capture_path) {
+        print_usage_and_exit();
+    }
+
+    return options;
+}
+
+static int compare_floats(const void* a, const void* b)
+{
+    float x = *(const float*)a;
+    float y = *(const float*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[])
+{
+    ReplayOptions options = parse_options(argc, argv);
+
+    CaptureReader reader;
+    if (!capture_reader_open(&reader, options.capture_path)) {
+        log_fatal("Could not open %s", options.capture_path);
+    }
+
+    if (!SDL_Init(SDL_INIT_VIDEO)) {
+        log_fatal("%s", SDL_GetError());
+    }
+
+    SDL_Window* window = SDL_CreateWindow("Replay", 1280, 720, 0);
+    if (!window) {
+        log_fatal("%s", SDL_GetError());
+    }
+
+    if (!renderer_init(&renderer, window, &options.renderer_config)) {
+        log_fatal("Could not initialize the renderer");
+    }
+
+    Replay replay = {};
+    replay.draw_list.allocate_page = allocate_draw_list_page;
+
+    if (!handle_map_init(&replay.meshes) || !handle_map_init(&replay.textures) || !handle_map_init(&replay.materials)) {
+        log_fatal("Out of memory");
+    }
+
+    float* frame_times = NULL;
+    size_t frame_count = 0;
+    size_t frame_capacity = 0;
+
+    printf("frame,total_ms,record_ms,submit_ms,swapchain_wait_ms,draw_calls,triangles,upload_bytes\n");
+
+    Uint64 frequency = SDL_GetPerformanceFrequency();
+    bool running = true;
+
+    // Later loops replay only the draw lists: creation and destruction records
+    // are both skipped so nothing is uploaded again. Resources are then as the
+    // first loop left them, a draw whose resource the trace destroyed before
+    // the end is dropped in every later loop, even in frames that drew it in
+    // the first.
+    for (Uint32 loop = 0; loop < options.loops && running; loop++) {
+        capture_reader_rewind(&reader);
+
+        CaptureRecordType type;
+        const uint8_t* payload;
+        Uint32 size;
+
+        while (running && capture_reader_next(&reader, &type, &payload, &size)) {
+            if (type != CAPTURE_RECORD_FRAME) {
+                if (loop == 0) {
+                    replay_resource(&replay, type, payload, size);
+                }
+                continue;
+            }
+
+            SDL_Event event;
+            while (SDL_PollEvent(&event)) {
+                if (event.type == SDL_EVENT_QUIT) {
+                    running = false;
+                }
+            }
+
+            replay_build_draw_list(&replay, payload, size);
+
+            Uint64 start = SDL_GetPerformanceCounter();
+            renderer_play_draw_list(&renderer, &replay.draw_list);
+            float total_ms = (float)((double)(SDL_GetPerformanceCounter() - start) * 1000.0 / (double)frequency);
+
+            RenderStats* stats = &replay.draw_list.stats;
+
+            printf("%zu,%.3f,%.3f,%.3f,%.3f,%u,%u,%llu\n", frame_count, total_ms, stats->record_ms, stats->submit_ms,
+                stats->swapchain_wait_ms, stats->draw_calls, stats->triangles, (unsigned long long)stats->upload_bytes);
+
+            if (frame_count == frame_capacity) {
+                frame_capacity = frame_capacity == 0 ? 1024 : frame_capacity * 2;
+                frame_times = (float*)SDL_realloc(frame_times, frame_capacity * sizeof(float));
+                if (!frame_times) {
+                    log_fatal("Out of memory");
+                }
+            }
+
+            frame_times[frame_count++] = total_ms;
+        }
+    }
+
+    if (frame_count > 0) {
+        double sum = 0.0;
+        for (size_t i = 0; i < frame_count; i++) {
+            sum += frame_times[i];
+        }
+
+        qsort(frame_times, frame_count, sizeof(float), compare_floats);
+
+        log_info("%zu frames | mean %.3f ms | p50 %.3f ms | p95 %.3f ms | p99 %.3f ms | max %.3f ms",
+            frame_count, sum / (double)frame_count,
+            frame_times[frame_count / 2],
+            frame_times[frame_count * 95 / 100],
+            frame_times[frame_count * 99 / 100],
+            frame_times[frame_count - 1]);
+    }
+
+    capture_reader_close(&reader);
+    renderer_shutdown(&renderer);
+    SDL_DestroyWindow(window);
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include "resolution_scaler.h"
+
+// Weight of the newest frame in the smoothed frame time
+#define RESOLUTION_SMOOTHING 0.1f
+// Fraction of the remaining error corrected each frame
+#define RESOLUTION_RESPONSE 0.1f
+// No adjustment while frame time over budget is within this band, vsync holds
+// frames right at the refresh interval
+#define RESOLUTION_LOAD_LOW 0.85f
+#define RESOLUTION_LOAD_HIGH 1.02f
+
+void resolution_scaler_init(ResolutionScaler* scaler, float budget_ms)
+{
+    scaler->budget_ms = budget_ms;
+    scaler->scale = 1.0f;
+    scaler->smoothed_frame_ms = budget_ms;
+}
+
+void resolution_scaler_update(ResolutionScaler* scaler, float frame_ms)
+{
+    if (scaler->budget_ms <= 0.0f) {
+        return;
+    }
+
+    scaler->smoothed_frame_ms += (frame_ms - scaler->smoothed_frame_ms) * RESOLUTION_SMOOTHING;
+
+    float load = scaler->smoothed_frame_ms / scaler->budget_ms;
+    if (load >= RESOLUTION_LOAD_LOW && load <= RESOLUTION_LOAD_HIGH) {
+        return;
+    }
+
+    // Pixel cost grows with the square of the scale
+    float target = scaler->scale / SDL_sqrtf(SDL_max(load, 0.01f));
+    float scale = scaler->scale + (target - scaler->scale) * RESOLUTION_RESPONSE;
+
+    scaler->scale = SDL_clamp(scale, RESOLUTION_SCALE_MIN, RESOLUTION_SCALE_MAX);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <SDL3/SDL_stdinc.h>
+
+#define RESOLUTION_SCALE_MIN 0.5f
+#define RESOLUTION_SCALE_MAX 1.0f
+
+// Picks the fraction of the window resolution the scene is rendered at so the
+// frame time stays within budget_ms. A budget of 0 pins the scale to 1.
+typedef struct {
+    float budget_ms;
+    float scale;
+    float smoothed_frame_ms;
+} ResolutionScaler;
+
+void resolution_scaler_init(ResolutionScaler* scaler, float budget_ms);
+
+// Feeds the time the renderer spent on the last frame: recording, submitting
+// and waiting for the swapchain, but not any frame limiter sleep
+void resolution_scaler_update(ResolutionScaler* scaler, float frame_ms);
@@ -0,0 +1,82 @@
+#include "slot_map.h"
+
+static Uint32 make_handle(Uint32 index, Uint32 generation)
+{
+    return (generation << SLOT_MAP_INDEX_BITS) | (index + 1);
+}
+
+static Uint32 handle_generation(Uint32 handle)
+{
+    return handle >> SLOT_MAP_INDEX_BITS;
+}
+
+bool slot_map_init(SlotMap* map, Uint32 capacity)
+{
+    SDL_zerop(map);
+
+    if (capacity > SLOT_MAP_MAX_SLOTS) {
+        return false;
+    }
+
+    map->generations = (SDL_AtomicU32*)SDL_calloc(capacity, sizeof(SDL_AtomicU32));
+    map->free_slots = (Uint32*)SDL_malloc(capacity * sizeof(Uint32));
+
+    if (!map->generations || !map->free_slots) {
+        SDL_free(map->generations);
+        SDL_free(map->free_slots);
+        return false;
+    }
+
+    map->capacity = capacity;
+
+    return true;
+}
+
+Uint32 slot_map_alloc(SlotMap* map)
+{
+    SDL_LockSpinlock(&map->lock);
+
+    Uint32 index;
+    if (map->free_count > 0) {
+        index = map->free_slots[--map->free_count];
+    } else if (map->used_count < map->capacity) {
+        index = map->used_count++;
+    } else {
+        SDL_UnlockSpinlock(&map->lock);
+        return 0;
+    }
+
+    SDL_UnlockSpinlock(&map->lock);
+
+    return make_handle(index, SDL_GetAtomicU32(&map->generations[index]));
+}
+
+bool slot_map_retire(SlotMap* map, Uint32 handle)
+{
+    if (!slot_map_is_live(map, handle)) {
+        return false;
+    }
+
+    Uint32 generation = handle_generation(handle);
+    Uint32 next_generation = (generation + 1) & (0xFFFFFFFFu >> SLOT_MAP_INDEX_BITS);
+
+    return SDL_CompareAndSwapAtomicU32(&map->generations[slot_map_index(handle)], generation, next_generation);
+}
+
+void slot_map_release(SlotMap* map, Uint32 handle)
+{
+    SDL_LockSpinlock(&map->lock);
+    map->free_slots[map->free_count++] = slot_map_index(handle);
+    SDL_UnlockSpinlock(&map->lock);
+}
+
+bool slot_map_is_live(const SlotMap* map, Uint32 handle)
+{
+    Uint32 index = slot_map_index(handle);
+
+    if (handle == 0 || index >= map->capacity) {
+        return false;
+    }
+
+    return SDL_GetAtomicU32((SDL_AtomicU32*)&map->generations[index]) == handle_generation(handle);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_stdinc.h>
+
+// Handle values pack a slot generation above the slot index. The index is
+// stored plus one so that 0 stays the invalid handle.
+#define SLOT_MAP_INDEX_BITS 16
+#define SLOT_MAP_INDEX_MASK ((1u << SLOT_MAP_INDEX_BITS) - 1)
+#define SLOT_MAP_MAX_SLOTS SLOT_MAP_INDEX_MASK
+
+// Hands out generational handles for a fixed number of slots. Retiring a
+// handle bumps its slot generation, which makes every copy of it stale at
+// once. The slot index only returns to the free list once released, so the
+// owner can finish tearing the resource down first.
+//
+// Allocation and release may happen on any thread.
+typedef struct {
+    SDL_AtomicU32* generations;
+    Uint32* free_slots;
+    Uint32 free_count;
+    Uint32 used_count;
+    Uint32 capacity;
+    SDL_SpinLock lock;
+} SlotMap;
+
+bool slot_map_init(SlotMap* map, Uint32 capacity);
+
+// Returns 0 when every slot is in use
+Uint32 slot_map_alloc(SlotMap* map);
+
+// Makes handle stale, returns false if it already was
+bool slot_map_retire(SlotMap* map, Uint32 handle);
+
+// Puts the slot of a retired handle back on the free list
+void slot_map_release(SlotMap* map, Uint32 handle);
+
+bool slot_map_is_live(const SlotMap* map, Uint32 handle);
+
+inline Uint32 slot_map_index(Uint32 handle)
+{
+    return (handle & SLOT_MAP_INDEX_MASK) - 1;
+}
@@ -0,0 +1,116 @@
+#include "transform_batch.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRANSFORM_BATCH_SSE
+#endif
+
+static void transform_to_matrix(const Transform* transform, glm::mat4* out_matrix)
+{
+    glm::quat q = transform->rotation;
+
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    glm::vec3 s = transform->scale;
+    glm::vec3 p = transform->position;
+
+    (*out_matrix)[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f) * s.x;
+    (*out_matrix)[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f) * s.y;
+    (*out_matrix)[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f) * s.z;
+    (*out_matrix)[3] = glm::vec4(p, 1.0f);
+}
+
+static glm::mat4* output_matrix(glm::mat4* out_matrices, size_t out_stride, size_t index)
+{
+    return (glm::mat4*)((uint8_t*)out_matrices + index * out_stride);
+}
+
+void transforms_to_matrices(const Transform* const* transforms, glm::mat4* out_matrices, size_t out_stride, size_t count)
+{
+    size_t i = 0;
+
+#ifdef TRANSFORM_BATCH_SSE
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    for (; i + 4 <= count; i += 4) {
+        const Transform* t0 = transforms[i + 0];
+        const Transform* t1 = transforms[i + 1];
+        const Transform* t2 = transforms[i + 2];
+        const Transform* t3 = transforms[i + 3];
+
+        // Gather the four transforms into SoA lanes
+        __m128 qx = _mm_setr_ps(t0->rotation.x, t1->rotation.x, t2->rotation.x, t3->rotation.x);
+        __m128 qy = _mm_setr_ps(t0->rotation.y, t1->rotation.y, t2->rotation.y, t3->rotation.y);
+        __m128 qz = _mm_setr_ps(t0->rotation.z, t1->rotation.z, t2->rotation.z, t3->rotation.z);
+        __m128 qw = _mm_setr_ps(t0->rotation.w, t1->rotation.w, t2->rotation.w, t3->rotation.w);
+
+        __m128 sx = _mm_setr_ps(t0->scale.x, t1->scale.x, t2->scale.x, t3->scale.x);
+        __m128 sy = _mm_setr_ps(t0->scale.y, t1->scale.y, t2->scale.y, t3->scale.y);
+        __m128 sz = _mm_setr_ps(t0->scale.z, t1->scale.z, t2->scale.z, t3->scale.z);
+
+        __m128 px = _mm_setr_ps(t0->position.x, t1->position.x, t2->position.x, t3->position.x);
+        __m128 py = _mm_setr_ps(t0->position.y, t1->position.y, t2->position.y, t3->position.y);
+        __m128 pz = _mm_setr_ps(t0->position.z, t1->position.z, t2->position.z, t3->position.z);
+
+        __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+        __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+        __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+        // Rotation columns scaled per axis, element cRC is column C row R
+        __m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+        __m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+        __m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+        __m128 c0w = _mm_setzero_ps();
+
+        __m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+        __m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+        __m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+        __m128 c1w = _mm_setzero_ps();
+
+        __m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+        __m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+        __m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+        __m128 c2w = _mm_setzero_ps();
+
+        __m128 c3w = one;
+
+        // Transpose back so each register holds one column of one matrix
+        _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+        _MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+        _MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+        _MM_TRANSPOSE4_PS(px, py, pz, c3w);
+
+        float* m0 = &(*output_matrix(out_matrices, out_stride, i + 0))[0][0];
+        float* m1 = &(*output_matrix(out_matrices, out_stride, i + 1))[0][0];
+        float* m2 = &(*output_matrix(out_matrices, out_stride, i + 2))[0][0];
+        float* m3 = &(*output_matrix(out_matrices, out_stride, i + 3))[0][0];
+
+        _mm_storeu_ps(m0 + 0, c0x);
+        _mm_storeu_ps(m0 + 4, c1x);
+        _mm_storeu_ps(m0 + 8, c2x);
+        _mm_storeu_ps(m0 + 12, px);
+
+        _mm_storeu_ps(m1 + 0, c0y);
+        _mm_storeu_ps(m1 + 4, c1y);
+        _mm_storeu_ps(m1 + 8, c2y);
+        _mm_storeu_ps(m1 + 12, py);
+
+        _mm_storeu_ps(m2 + 0, c0z);
+        _mm_storeu_ps(m2 + 4, c1z);
+        _mm_storeu_ps(m2 + 8, c2z);
+        _mm_storeu_ps(m2 + 12, pz);
+
+        _mm_storeu_ps(m3 + 0, c0w);
+        _mm_storeu_ps(m3 + 4, c1w);
+        _mm_storeu_ps(m3 + 8, c2w);
+        _mm_storeu_ps(m3 + 12, c3w);
+    }
+#endif
+
+    for (; i < count; i++) {
+        transform_to_matrix(transforms[i], output_matrix(out_matrices, out_stride, i));
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "public/almond.h"
+
+// Builds translate * rotate * scale model matrices for count transforms,
+// matching glm::translate/mat4_cast/scale. Transforms are processed four at
+// a time in SoA registers when SSE is available. Consecutive output matrices
+// are out_stride bytes apart so they can be written straight into larger
+// per-draw records.
+void transforms_to_matrices(const Transform* const* transforms, glm::mat4* out_matrices, size_t out_stride, size_t count);
@@ -0,0 +1,155 @@
+#include "upload_queue.h"
+
+bool upload_queue_init(UploadQueue* queue, Uint32 capacity)
+{
+    // Capacity must be a power of two so positions can be masked into cells
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+
+    queue->cells = (UploadQueueCell*)SDL_calloc(capacity, sizeof(UploadQueueCell));
+    if (!queue->cells) {
+        return false;
+    }
+
+    for (Uint32 i = 0; i < capacity; i++) {
+        SDL_SetAtomicU32(&queue->cells[i].sequence, i);
+    }
+
+    queue->mask = capacity - 1;
+    SDL_SetAtomicU32(&queue->enqueue_pos, 0);
+    SDL_SetAtomicU32(&queue->dequeue_pos, 0);
+
+    queue->overflow_lock = 0;
+    queue->overflow = NULL;
+    queue->overflow_read = 0;
+    queue->overflow_count = 0;
+    queue->overflow_capacity = 0;
+    SDL_SetAtomicInt(&queue->overflow_pending, 0);
+
+    return true;
+}
+
+static bool ring_push(UploadQueue* queue, const UploadRequest* request)
+{
+    UploadQueueCell* cell;
+    Uint32 pos = SDL_GetAtomicU32(&queue->enqueue_pos);
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        Uint32 sequence = SDL_GetAtomicU32(&cell->sequence);
+        Sint32 diff = (Sint32)(sequence - pos);
+
+        if (diff == 0) {
+            if (SDL_CompareAndSwapAtomicU32(&queue->enqueue_pos, pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full
+            return false;
+        }
+
+        pos = SDL_GetAtomicU32(&queue->enqueue_pos);
+    }
+
+    cell->request = *request;
+
+    SDL_MemoryBarrierRelease();
+    SDL_SetAtomicU32(&cell->sequence, pos + 1);
+
+    return true;
+}
+
+static bool overflow_push(UploadQueue* queue, const UploadRequest* request)
+{
+    SDL_LockSpinlock(&queue->overflow_lock);
+
+    if (queue->overflow_count == queue->overflow_capacity) {
+        size_t capacity = queue->overflow_capacity == 0 ? 256 : queue->overflow_capacity * 2;
+
+        auto* overflow = (UploadRequest*)SDL_realloc(queue->overflow, capacity * sizeof(UploadRequest));
+        if (!overflow) {
+            SDL_UnlockSpinlock(&queue->overflow_lock);
+            return false;
+        }
+
+        queue->overflow = overflow;
+        queue->overflow_capacity = capacity;
+    }
+
+    queue->overflow[queue->overflow_count++] = *request;
+    SDL_AddAtomicInt(&queue->overflow_pending, 1);
+
+    SDL_UnlockSpinlock(&queue->overflow_lock);
+
+    return true;
+}
+
+bool upload_queue_push(UploadQueue* queue, const UploadRequest* request)
+{
+    if (SDL_GetAtomicInt(&queue->overflow_pending) == 0 && ring_push(queue, request)) {
+        return true;
+    }
+
+    return overflow_push(queue, request);
+}
+
+static bool overflow_pop(UploadQueue* queue, UploadRequest* out_request)
+{
+    SDL_LockSpinlock(&queue->overflow_lock);
+
+    if (queue->overflow_read == queue->overflow_count) {
+        SDL_UnlockSpinlock(&queue->overflow_lock);
+        return false;
+    }
+
+    *out_request = queue->overflow[queue->overflow_read++];
+
+    if (queue->overflow_read == queue->overflow_count) {
+        queue->overflow_read = 0;
+        queue->overflow_count = 0;
+    }
+
+    SDL_AddAtomicInt(&queue->overflow_pending, -1);
+
+    SDL_UnlockSpinlock(&queue->overflow_lock);
+
+    return true;
+}
+
+static bool ring_pop(UploadQueue* queue, UploadRequest* out_request)
+{
+    UploadQueueCell* cell;
+    Uint32 pos = SDL_GetAtomicU32(&queue->dequeue_pos);
+
+    for (;;) {
+        cell = &queue->cells[pos & queue->mask];
+        Uint32 sequence = SDL_GetAtomicU32(&cell->sequence);
+        Sint32 diff = (Sint32)(sequence - (pos + 1));
+
+        if (diff == 0) {
+            if (SDL_CompareAndSwapAtomicU32(&queue->dequeue_pos, pos, pos + 1)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Empty
+            return false;
+        }
+
+        pos = SDL_GetAtomicU32(&queue->dequeue_pos);
+    }
+
+    SDL_MemoryBarrierAcquire();
+    *out_request = cell->request;
+
+    SDL_MemoryBarrierRelease();
+    SDL_SetAtomicU32(&cell->sequence, pos + queue->mask + 1);
+
+    return true;
+}
+
+// Spilled requests are newer than everything in the ring, which is drained first
+bool upload_queue_pop(UploadQueue* queue, UploadRequest* out_request)
+{
+    return ring_pop(queue, out_request) || overflow_pop(queue, out_request);
+}
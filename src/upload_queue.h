@@ -0,0 +1,69 @@
+#pragma once
+
+#include "public/almond.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_stdinc.h>
+
+typedef enum {
+    UPLOAD_REQUEST_MESH,
+    // Reserves the pool ranges of a dynamic mesh, carries no data
+    UPLOAD_REQUEST_DYNAMIC_MESH,
+    UPLOAD_REQUEST_TEXTURE,
+    UPLOAD_REQUEST_MATERIAL,
+    UPLOAD_REQUEST_DESTROY_MESH,
+    UPLOAD_REQUEST_DESTROY_TEXTURE,
+} UploadRequestType;
+
+// A resource creation or destruction recorded by the game. Creation requests
+// own a copy of the source data (allocated with SDL_malloc) until the renderer
+// uploads it.
+typedef struct {
+    UploadRequestType type;
+    Uint32 handle;
+    void* data;
+    size_t data_size;
+
+    Uint32 vertices_count;
+    Uint32 indices_count;
+
+    TextureFormat format;
+    Uint32 width;
+    Uint32 height;
+    // 0 generates the mip chain from the first level on the GPU
+    Uint32 mip_count;
+
+    Uint32 albedo;
+    MaterialFlags material_flags;
+} UploadRequest;
+
+typedef struct {
+    SDL_AtomicU32 sequence;
+    UploadRequest request;
+} UploadQueueCell;
+
+// Bounded lock-free queue (Vyukov). Any thread may push, the renderer pops.
+// Requests that find the ring full spill into a growable overflow list under
+// a lock. Once a request has spilled, later ones follow it there until the
+// renderer drains the list, so requests still come out in the order they
+// were pushed.
+typedef struct {
+    UploadQueueCell* cells;
+    Uint32 mask;
+    SDL_AtomicU32 enqueue_pos;
+    SDL_AtomicU32 dequeue_pos;
+
+    SDL_SpinLock overflow_lock;
+    UploadRequest* overflow;
+    size_t overflow_read;
+    size_t overflow_count;
+    size_t overflow_capacity;
+    // Requests in the overflow list, read without the lock
+    SDL_AtomicInt overflow_pending;
+} UploadQueue;
+
+bool upload_queue_init(UploadQueue* queue, Uint32 capacity);
+
+// Only fails when the overflow list cannot grow
+bool upload_queue_push(UploadQueue* queue, const UploadRequest* request);
+bool upload_queue_pop(UploadQueue* queue, UploadRequest* out_request);